@@ -0,0 +1,55 @@
+/************************************************************************************/
+// blackbox.cpp
+// Content: black box of the HAL (blackbox.h)
+// the ring is owned by the HAL while recording and by the comm task while frozen,
+// blackbox_state hands it over, neither side ever waits for the other
+/************************************************************************************/
+
+#include <atomic>
+
+#include "blackbox.h"
+
+#define BLACKBOX_RECORDING			0
+#define BLACKBOX_FREEZE_REQUESTED	1
+#define BLACKBOX_FROZEN				2
+
+static s_blackbox_record blackbox_ring[BLACKBOX_RECORDS];
+static uint32_t blackbox_count = 0; //written by the HAL only
+static std::atomic<uint8_t> blackbox_state(BLACKBOX_RECORDING);
+static std::atomic<uint32_t> blackbox_frozen_count(0);
+
+void blackbox_record(const s_blackbox_record &record){
+	uint8_t state = blackbox_state.load(std::memory_order_acquire);
+	if (state == BLACKBOX_RECORDING){
+		blackbox_ring[blackbox_count % BLACKBOX_RECORDS] = record;
+		blackbox_count++;
+		return;
+	}
+	if (state == BLACKBOX_FREEZE_REQUESTED){
+		//every record written so far is complete, hand the ring over - unless the comm task released it meanwhile
+		blackbox_frozen_count.store(blackbox_count, std::memory_order_relaxed);
+		uint8_t expected = BLACKBOX_FREEZE_REQUESTED;
+		blackbox_state.compare_exchange_strong(expected, BLACKBOX_FROZEN, std::memory_order_acq_rel);
+	}
+}
+
+void blackbox_freeze(void){
+	uint8_t expected = BLACKBOX_RECORDING;
+	blackbox_state.compare_exchange_strong(expected, BLACKBOX_FREEZE_REQUESTED, std::memory_order_acq_rel);
+}
+
+bool blackbox_frozen(uint32_t &count){
+	if (blackbox_state.load(std::memory_order_acquire) != BLACKBOX_FROZEN){
+		return false;
+	}
+	count = blackbox_frozen_count.load(std::memory_order_relaxed);
+	return true;
+}
+
+const s_blackbox_record &blackbox_get(uint32_t index){
+	return blackbox_ring[index % BLACKBOX_RECORDS];
+}
+
+void blackbox_release(void){
+	blackbox_state.store(BLACKBOX_RECORDING, std::memory_order_release);
+}
@@ -0,0 +1,41 @@
+// blackbox.h
+
+#ifndef _BLACKBOX_h
+#define _BLACKBOX_h
+
+#include "Arduino.h"
+#include "defines.h"
+#include "transmitter_protocol.h"
+
+//RAM ring of the last BLACKBOX_RECORDS HAL loops, fetched by the server on demand (s_blackbox_request)
+//the HAL writes a record every loop and never waits: for a dump the comm task asks it to stop recording,
+//the HAL acknowledges with the next record and leaves the ring alone until the comm task releases it
+//
+//	HAL:	blackbox_record(record);
+//	comm:	blackbox_freeze();
+//			while (!blackbox_frozen(count)) ...next tick...
+//			blackbox_get(index) for the newest min(count, BLACKBOX_RECORDS) indices below count
+//			blackbox_release();
+
+//one HAL loop, all channels
+struct s_blackbox_record{
+	uint32_t timestamp_us; //micros() of the loop
+	uint8_t flags; //BLACKBOX_FLAG_*
+	uint16_t raw[CHANNEL_COUNT];
+	uint16_t filtered[CHANNEL_COUNT];
+	uint8_t normalized[CHANNEL_COUNT];
+	uint8_t out[CHANNEL_COUNT];
+};
+
+//HAL task only, dropped while frozen
+void blackbox_record(const s_blackbox_record &record);
+
+//comm task only
+void blackbox_freeze(void);
+//true once the HAL stopped recording, count is the number of records written since boot
+bool blackbox_frozen(uint32_t &count);
+//record index (count - BLACKBOX_RECORDS <= index < count), only while frozen
+const s_blackbox_record &blackbox_get(uint32_t index);
+void blackbox_release(void);
+
+#endif
@@ -0,0 +1,121 @@
+/************************************************************************************/
+// calibration.cpp
+// Content: calibration lookup tables of the HAL
+// the three point interpolation maps (min, center, max) are compiled into dense tables
+// the ADC table is rebuilt in the segments around a changed map point only
+// the maps are persisted (storage.h), so a reboot does not need a new calibration
+/************************************************************************************/
+
+#include <CRC32.h>
+
+#include "calibration.h"
+#include "channels.h"
+#include "storage.h"
+
+//LUT based linear interpolation
+//stolen from https://playground.arduino.cc/Main/MultiMap
+//gently modified...
+uint16_t multiMap(uint16_t val, uint16_t* _in, uint16_t* _out, uint8_t size)
+{
+	// take care the value is within range
+	// val = constrain(val, _in[0], _in[size-1]);
+	if (val <= _in[0]) return _out[0];
+	if (val >= _in[size - 1]) return _out[size - 1];
+
+	// search right interval
+	uint8_t pos = 1;  // _in[0] allready tested
+	while (val > _in[pos]) pos++;
+
+	// this will handle all exact "points" in the _in array
+	if (val == _in[pos]) return _out[pos];
+
+	// interpolate in the right segment for the rest
+	return (val - _in[pos - 1]) * (_out[pos] - _out[pos - 1]) / (_in[pos] - _in[pos - 1]) + _out[pos - 1];
+}
+
+void calibration_build_out(s_calibration_lut &lut, uint16_t *map_out, long override_min, long override_max){
+	uint16_t map_normalized[MAP_SIZE] = { NORMALIZED_MIN_OUT, NORMALIZED_CNT_OUT, NORMALIZED_MAX_OUT };
+
+	for (int i = 0; i < CALIBRATION_NORMALIZED_SIZE; i++){
+		lut.normalized_to_out[i] = multiMap(i, map_normalized, map_out, MAP_SIZE);
+	}
+	for (int i = 0; i < CALIBRATION_NORMALIZED_SIZE; i++){
+		//the override is scaled into a normalized value (uint8_t) before de-normalizing
+		uint8_t normalized_override = map(i, 0, 255, override_min, override_max);
+		lut.override_to_out[i] = multiMap(normalized_override, map_normalized, map_out, MAP_SIZE);
+	}
+}
+
+void calibration_update_in(s_calibration_lut &lut, uint16_t *map_in){
+	uint16_t map_normalized[MAP_SIZE] = { NORMALIZED_MIN_OUT, NORMALIZED_CNT_OUT, NORMALIZED_MAX_OUT };
+	int first = CALIBRATION_ADC_SIZE;
+	int last = -1;
+
+	//a map point only shapes the segments to its neighbours, the rest of the table stays
+	for (int i = 0; i < MAP_SIZE; i++){
+		if (lut.valid && lut.map_in[i] == map_in[i]){
+			continue;
+		}
+		int segment_first = (i == 0) ? 0 : map_in[i - 1];
+		int segment_last = (i == MAP_SIZE - 1) ? CALIBRATION_ADC_SIZE - 1 : map_in[i + 1];
+		if (segment_first < first){
+			first = segment_first;
+		}
+		if (segment_last > last){
+			last = segment_last;
+		}
+	}
+	if (last >= CALIBRATION_ADC_SIZE){
+		last = CALIBRATION_ADC_SIZE - 1;
+	}
+
+	for (int adc = first; adc <= last; adc++){
+		lut.adc_to_normalized[adc] = multiMap(adc, map_in, map_normalized, MAP_SIZE);
+	}
+	memcpy(lut.map_in, map_in, sizeof(lut.map_in));
+	lut.valid = true;
+}
+
+bool calibration_usable(const uint16_t map_in[CHANNEL_COUNT][MAP_SIZE]){
+	//same acceptance as the live calibration of the HAL
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+		if (!channel_table[channel].calibrate){
+			continue;
+		}
+		if (map_in[channel][MAP_MIN_INDEX] + MINIMAL_ACCEPTED_CALIBRATION_RANGE >= map_in[channel][MAP_CENTER_INDEX]
+			|| map_in[channel][MAP_MAX_INDEX] - MINIMAL_ACCEPTED_CALIBRATION_RANGE <= map_in[channel][MAP_CENTER_INDEX]){
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint32_t calibration_record_crc(const s_calibration_record &record){
+	return CRC32::calculate((const uint8_t *)&record, offsetof(s_calibration_record, CRC));
+}
+
+bool calibration_restore(uint16_t map_in[CHANNEL_COUNT][MAP_SIZE]){
+	s_calibration_record record;
+	if (!storage_read(CALIBRATION_STORAGE_KEY, &record, sizeof(s_calibration_record))){
+		return false;
+	}
+	if (record.version != CALIBRATION_RECORD_VERSION || record.channel_count != CHANNEL_COUNT || record.CRC != calibration_record_crc(record)){
+		return false;
+	}
+	if (!calibration_usable(record.map_in)){
+		return false;
+	}
+	memcpy(map_in, record.map_in, sizeof(record.map_in));
+	return true;
+}
+
+bool calibration_persist(const uint16_t map_in[CHANNEL_COUNT][MAP_SIZE]){
+	s_calibration_record record;
+	//the padding in front of the CRC depends on CHANNEL_COUNT, it is covered by the CRC as well
+	memset(&record, 0, sizeof(s_calibration_record));
+	record.version = CALIBRATION_RECORD_VERSION;
+	record.channel_count = CHANNEL_COUNT;
+	memcpy(record.map_in, map_in, sizeof(record.map_in));
+	record.CRC = calibration_record_crc(record);
+	return storage_write(CALIBRATION_STORAGE_KEY, &record, sizeof(s_calibration_record));
+}
@@ -0,0 +1,60 @@
+// calibration.h
+
+#ifndef _CALIBRATION_h
+#define _CALIBRATION_h
+
+#include "Arduino.h"
+#include "defines.h"
+
+//one entry per 12 bit ADC value
+#define CALIBRATION_ADC_SIZE		4096
+//one entry per normalized (uint8_t) value
+#define CALIBRATION_NORMALIZED_SIZE	256
+
+//the interpolation maps of one channel compiled into lookup tables
+//mapping a sample is a single table load instead of a multiMap() search and division
+struct s_calibration_lut{
+	uint8_t adc_to_normalized[CALIBRATION_ADC_SIZE];
+	uint8_t normalized_to_out[CALIBRATION_NORMALIZED_SIZE];
+	//override value from the master to out, includes the scaling of the override
+	uint8_t override_to_out[CALIBRATION_NORMALIZED_SIZE];
+	//map_in the adc table was built from, to rebuild only what changed
+	uint16_t map_in[MAP_SIZE];
+	bool valid;
+};
+
+//calibration as stored, see calibration_restore/calibration_persist
+#define CALIBRATION_STORAGE_KEY		"calibration"
+#define CALIBRATION_RECORD_VERSION	2
+
+//a record of another channel count is not restored
+struct s_calibration_record{
+	uint16_t version;
+	uint8_t channel_count;
+	uint8_t reserved; //zero
+	uint16_t map_in[CHANNEL_COUNT][MAP_SIZE];
+	uint32_t CRC; //over everything in front of it, including the padding
+};
+
+//LUT based linear interpolation, the reference the tables are built from
+uint16_t multiMap(uint16_t val, uint16_t* _in, uint16_t* _out, uint8_t size);
+
+//builds the normalized to out tables, override values 0-255 are scaled to override_min-override_max first
+void calibration_build_out(s_calibration_lut &lut, uint16_t *map_out, long override_min, long override_max);
+//builds the adc table from map_in, only the segments next to changed map points are rebuilt
+void calibration_update_in(s_calibration_lut &lut, uint16_t *map_in);
+
+//true if the maps span at least MINIMAL_ACCEPTED_CALIBRATION_RANGE around the center
+//on every channel that is calibrated (channels.h), the others are not looked at
+bool calibration_usable(const uint16_t map_in[CHANNEL_COUNT][MAP_SIZE]);
+//loads the stored calibration, false (maps untouched) if there is none or it is broken or unusable
+bool calibration_restore(uint16_t map_in[CHANNEL_COUNT][MAP_SIZE]);
+//stores the calibration, false if the storage failed
+bool calibration_persist(const uint16_t map_in[CHANNEL_COUNT][MAP_SIZE]);
+
+//12 bit ADC value to normalized
+inline uint8_t calibration_normalize(const s_calibration_lut &lut, uint16_t adc){
+	return lut.adc_to_normalized[adc < CALIBRATION_ADC_SIZE ? adc : CALIBRATION_ADC_SIZE - 1];
+}
+
+#endif
@@ -0,0 +1,20 @@
+/************************************************************************************/
+// channels.cpp
+// Content: analog channel table of the HAL (channels.h)
+// the row index is the channel number on the wire (transmitter_protocol.h)
+/************************************************************************************/
+
+#include "channels.h"
+#include "filter.h"
+
+static_assert(CHANNEL_COUNT > TRANSMITTER_CHANNEL_STEER, "throttle and steering are always there");
+static_assert(CHANNEL_COUNT <= TRANSMITTER_MAX_CHANNELS, "CHANNEL_COUNT exceeds the channels frame");
+
+const s_channel_descriptor channel_table[CHANNEL_COUNT] = {
+	//throttle, the override is scaled to THROTTLE_MIN_OUT-THROTTLE_MAX_OUT
+	{ THROTTLE_SENSE_PIN, THROTTLE_CONTROL_PIN, true, { THROTTLE_MIN_OUT, THROTTLE_CNT_OUT, THROTTLE_MAX_OUT },
+		THROTTLE_MIN_OUT, THROTTLE_MAX_OUT, THROTTLE_FILTER, THROTTLE_FILTER_PARAM },
+	//steering, the override is taken as is
+	{ STEERING_SENSE_PIN, STEERING_CONTROL_PIN, true, { STEER_MIN_OUT, STEER_CNT_OUT, STEER_MAX_OUT },
+		NORMALIZED_MIN_OUT, NORMALIZED_MAX_OUT, STEER_FILTER, STEER_FILTER_PARAM },
+};
@@ -0,0 +1,29 @@
+// channels.h
+
+#ifndef _CHANNELS_h
+#define _CHANNELS_h
+
+#include "Arduino.h"
+#include "defines.h"
+#include "transmitter_protocol.h"
+
+//channels that are only read and reported, the ESP32 has two DAC pins
+#define CHANNEL_NO_CONTROL_PIN		0xFF
+
+//one analog channel of the transmitter, the HAL runs every channel in channel_table the same way
+struct s_channel_descriptor{
+	uint8_t sense_pin; //ADC
+	uint8_t control_pin; //DAC, or CHANNEL_NO_CONTROL_PIN
+	bool calibrate; //min/center/max learned from the stick, the full ADC range otherwise
+	uint16_t map_out[MAP_SIZE]; //normalized to out, min/center/max
+	long override_min; //override values 0-255 are scaled to override_min-override_max (normalized)
+	long override_max;
+	uint8_t filter_type; //filter.h
+	uint8_t filter_param;
+};
+
+//CHANNEL_COUNT rows, index TRANSMITTER_CHANNEL_THROTTLE and TRANSMITTER_CHANNEL_STEER first
+//a new analog input is a new row and CHANNEL_COUNT + 1
+extern const s_channel_descriptor channel_table[CHANNEL_COUNT];
+
+#endif
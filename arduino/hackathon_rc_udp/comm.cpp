@@ -14,19 +14,55 @@
 
 #include "comm.h"
 #include "transmitter_hal.h"
+#include "blackbox.h"
+
+//frames are defined in transmitter_protocol.h, shared with the server
+static_assert(TELEMETRY_BATCH_SIZE <= TELEMETRY_BATCH_MAX_SAMPLES, "TELEMETRY_BATCH_SIZE exceeds the batch frame");
+static_assert(CHANNEL_COUNT <= TRANSMITTER_CHANNEL_STEER + 1 || TELEMETRY_PROTOCOL_VERSION >= 3, "the auxiliary channels need TELEMETRY_PROTOCOL_VERSION 3");
+
+s_transmitter_state_packet ts_packet;
+s_transmitter_state_packet_v2 ts_packet_v2;
+uint32_t telemetry_sequence = 0;
+uint32_t last_sent_sample_count = 0;
+
+//live data transmission, set at runtime by the server
+uint16_t telemetry_delay_ms = PACKET_DELAY_MS;
+uint8_t telemetry_mode = TELEMETRY_MODE_PERIODIC;
+uint16_t telemetry_heartbeat_ms = TELEMETRY_HEARTBEAT_MS;
+uint8_t telemetry_deadband = TELEMETRY_DEADBAND;
+bool telemetry_raw = false;
+s_transmitter_channels last_sent_channels;
+//newest state of the HAL, taken once per comm tick
+s_transmitter_state current_state;
+s_transmitter_channels current_channels;
+uint64_t last_telemetry_millis = 0;
+uint8_t batch_buffer[protocol_table_frame<s_transmitter_batch_header>::size(TELEMETRY_BATCH_SIZE)];
+uint8_t channels_buffer[protocol_table_frame<s_transmitter_channels_header>::size(CHANNEL_COUNT)];
+uint8_t raw_buffer[protocol_table_frame<s_transmitter_raw_header>::size(CHANNEL_COUNT)];
+
+//black box dump, the chunk asked for is sent once the HAL stopped recording
+bool blackbox_dumping = false;
+int32_t blackbox_requested_chunk = -1;
+uint32_t blackbox_dump_id = 0;
+uint64_t blackbox_last_request_millis = 0;
+uint8_t blackbox_buffer[protocol_table_frame<s_blackbox_chunk_header>::max_size];
 
-struct s_transmitter_state_packet{
-	uint8_t in_throttle;
-	uint8_t in_steer;
-	uint16_t in_button;
-	uint8_t out_throttle;
+//updates from master
+triple_buffer<s_transmitter_override> transmitter_output_override;
+volatile s_control_stats control_stats;
+
+//newest valid override of the current socket drain, applied once the socket is empty
+struct s_pending_override{
+	bool valid;
 	uint8_t out_steer;
-	uint16_t battery_voltage;
+	uint8_t out_throttle;
 	uint32_t CRC;
-}ts_packet __attribute__((packed));
+} pending_override;
 
-//updates from master
-volatile s_transmitter_override transmitter_output_override;
+//sequence number of the last accepted sequenced control packet
+bool control_sequence_valid = false;
+uint32_t last_control_sequence = 0;
+uint64_t last_control_sequence_millis = 0;
 
 char *send_buffer;
 char *recv_buffer;
@@ -43,6 +79,11 @@ const char *station_pwd;
 
 CRC32 crc;
 
+uint32_t frame_crc(const void *data, size_t length){
+	crc.reset();
+	return crc.calculate((const uint8_t *)data, length);
+}
+
 void TASK_comm_run(void *param);
 
 
@@ -64,7 +105,11 @@ void wifi_connect(){
 	//register event handler
 	WiFi.onEvent(wifi_event);
 	//listen for incoming packets
+#ifdef OVERRIDE_MULTICAST_ADDRESS
+	udp.beginMulticast(OVERRIDE_MULTICAST_ADDRESS, listen_port);
+#else
 	udp.begin(listen_port);
+#endif
 	//Initiate connection
 	WiFi.config(IPAddress(192, 168, 0, 103), IPAddress(192, 168, 0, 172), IPAddress(255, 255, 255, 0));
 	WiFi.begin(station_ssid, station_pwd);
@@ -90,7 +135,7 @@ void start_comm(void){
 
 
 int init_comm(const char * ssid, const char * pwd, const char *server_ip, uint16_t srv_port, uint16_t local_port){
-	connected == false;
+	connected = false;
 	station_ssid = ssid;
 	station_pwd = pwd;
 	server_address = server_ip;
@@ -98,26 +143,375 @@ int init_comm(const char * ssid, const char * pwd, const char *server_ip, uint16
 	listen_port = local_port;
 
 	wifi_connect();
+	return 0;
 }
 
 
 //The comm task is continously reporting the live transmitter state via UDP
 //and checking for responses to overwrite the transmitter settings
-#define INCOMING_PACKET_BUFSIZE		2 + 4	//steer(1), throttle(1) and CRC32(4)...
+//largest incoming frame is a full group override
+#define INCOMING_PACKET_BUFSIZE		(protocol_table_frame<s_group_override_header>::max_size)
+//datagrams handled per iteration at most, a burst larger than this is drained over the next ticks
+#define INCOMING_PACKET_DRAIN_MAX	16
+
+void apply_override(uint8_t steer_received, uint8_t throttle_received, uint32_t crc_received){
+	s_transmitter_override output_override;
+	output_override.out_steer = steer_received;
+	output_override.out_throttle = throttle_received;
+	output_override.CRC = crc_received;
+	output_override.millis_last_update = millis();
+	output_override.ready = true;
+	transmitter_output_override.write(output_override);
+}
+
+void offer_override(uint8_t steer_received, uint8_t throttle_received, uint32_t crc_received){
+	//latest wins, an older override of the same drain would be stale by the time it is applied
+	if (pending_override.valid){
+		control_stats.superseded++;
+	}
+	pending_override.valid = true;
+	pending_override.out_steer = steer_received;
+	pending_override.out_throttle = throttle_received;
+	pending_override.CRC = crc_received;
+	control_stats.received++;
+}
+
+void override_crc_error(void){
+	//crc error - zero struct - also sets ready to false :)
+	//whatever was pending from this drain is older than the broken packet, drop it as well
+	control_stats.crc_errors++;
+	pending_override.valid = false;
+	transmitter_output_override.write(s_transmitter_override());
+}
+
+void receive_control_packet(const uint8_t *incoming_packet_buffer, int rcv_len){
+	//seems to be a new packet from the master...
+	protocol_view<s_transmitter_control_packet> inc_packet(incoming_packet_buffer, rcv_len);
+
+	//Serial.printf("S: %d / T: %d (%u)\r\n", inc_packet->out_steer, inc_packet->out_throttle, inc_packet->CRC);
+
+	if (inc_packet.valid(frame_crc)){
+		offer_override(inc_packet->out_steer, inc_packet->out_throttle, inc_packet->CRC);
+	}
+	else{
+		Serial.println("CRC ERROR");
+		Serial.printf("R: %u\r\n", inc_packet->CRC);
+		override_crc_error();
+	}
+}
+
+void receive_control_packet_v2(const uint8_t *incoming_packet_buffer, int rcv_len){
+	protocol_view<s_transmitter_control_packet_v2> inc_packet(incoming_packet_buffer, rcv_len);
+	if (!inc_packet.valid(frame_crc)){
+		Serial.println("CRC ERROR (v2)");
+		override_crc_error();
+		return;
+	}
+
+	//only newer sequence numbers, unless the last one expired anyway (e.g. the server restarted and counts from 0)
+	if (control_sequence_valid
+		&& (int32_t)(inc_packet->sequence - last_control_sequence) <= 0
+		&& last_control_sequence_millis + OVERWRITE_PACKAGE_VALID_MS > millis()){
+		control_stats.stale++;
+		return;
+	}
+	control_sequence_valid = true;
+	last_control_sequence = inc_packet->sequence;
+	last_control_sequence_millis = millis();
+	offer_override(inc_packet->out_steer, inc_packet->out_throttle, inc_packet->CRC);
+}
+
+void receive_group_override(const uint8_t *incoming_packet_buffer, int rcv_len){
+	//one frame for many transmitters, pick our own slot
+	protocol_table_view<s_group_override_header> frame(incoming_packet_buffer, rcv_len);
+	if (!frame.has_header()){
+		return;
+	}
+	if (!frame.matches(frame.header()->slot_count)){
+		//Serial.printf("DEBUG: malformed group override, %d slots in %d bytes\r\n", frame.header()->slot_count, rcv_len);
+		return;
+	}
+	if (frame.header()->group_id != OVERRIDE_GROUP_ID && frame.header()->group_id != GROUP_ID_ALL){
+		return;
+	}
+	if (!frame.valid(frame.header()->slot_count, frame_crc)){
+		//crc error - same as for the control packet, stop overriding
+		Serial.println("CRC ERROR (group)");
+		override_crc_error();
+		return;
+	}
+
+	uint8_t transmitter_id = WiFi.localIP()[3];
+	for (int i = 0; i < frame.header()->slot_count; i++){
+		const s_group_override_slot *slot = frame.entry(i);
+		if (slot->transmitter_id == transmitter_id){
+			offer_override(slot->out_steer, slot->out_throttle, frame.crc(frame.header()->slot_count));
+			break;
+		}
+	}
+}
+
+int build_batch_frame(void){
+	//packs the HAL samples since the last frame (at most TELEMETRY_BATCH_SIZE, at least the newest) into batch_buffer
+	uint32_t sample_count_now = transmitter_samples.count();
+	uint32_t new_samples = sample_count_now - last_sent_sample_count;
+	if (sample_count_now == 0){
+		//HAL did not sample yet
+		return 0;
+	}
+	if (new_samples == 0){
+		new_samples = 1;
+	}
+	if (new_samples > TELEMETRY_BATCH_SIZE){
+		new_samples = TELEMETRY_BATCH_SIZE;
+	}
+	uint32_t first_sample = sample_count_now - new_samples;
+	last_sent_sample_count = sample_count_now;
+
+	//the HAL keeps writing, samples it overwrote while they were copied are dropped
+	s_transmitter_sample samples[TELEMETRY_BATCH_SIZE];
+	uint32_t overwritten = transmitter_samples.read(first_sample, new_samples, samples);
+	if (overwritten == new_samples){
+		return 0;
+	}
+	new_samples -= overwritten;
+
+	//built in place, the frame structs are packed
+	s_transmitter_batch_header *header = (s_transmitter_batch_header *)batch_buffer;
+	header->type = TRANSMITTER_FRAME_STATE_BATCH;
+	header->sample_count = new_samples;
+	header->sequence = telemetry_sequence++;
+	header->base_timestamp_us = samples[overwritten].timestamp_us;
+
+	s_transmitter_batch_sample *sample = (s_transmitter_batch_sample *)(batch_buffer + sizeof(s_transmitter_batch_header));
+	for (uint32_t i = 0; i < new_samples; i++, sample++){
+		const s_transmitter_sample &ring_sample(samples[overwritten + i]);
+		sample->offset_us = ring_sample.timestamp_us - header->base_timestamp_us;
+		sample->state = ring_sample.state;
+	}
+	header->send_offset_us = micros() - header->base_timestamp_us;
+
+	return protocol_seal_table<s_transmitter_batch_header>(batch_buffer, new_samples, frame_crc);
+}
+
+int build_channels_frame(void){
+	//packs the newest sample of all channels (current_channels) into channels_buffer
+	const s_transmitter_channels &channels(current_channels);
+
+	//built in place, the frame structs are packed
+	s_transmitter_channels_header *header = (s_transmitter_channels_header *)channels_buffer;
+	header->type = TRANSMITTER_FRAME_STATE_CHANNELS;
+	header->channel_count = CHANNEL_COUNT;
+	header->in_button = channels.in_button;
+	header->sequence = telemetry_sequence++;
+	header->timestamp_us = channels.timestamp_us;
+	header->battery_voltage_mv = channels.battery_voltage_mv;
+	header->reserved = 0;
+
+	s_transmitter_channel_value *value = (s_transmitter_channel_value *)(channels_buffer + sizeof(s_transmitter_channels_header));
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++, value++){
+		value->in = channels.in[channel];
+		value->out = channels.out[channel];
+	}
+
+	return protocol_seal_table<s_transmitter_channels_header>(channels_buffer, CHANNEL_COUNT, frame_crc);
+}
+
+void receive_clock_ping(const uint8_t *incoming_packet_buffer, int rcv_len, uint32_t device_rx_us){
+	//answer right away, every microsecond spent here is added to the measured round trip
+	protocol_view<s_clock_ping> ping(incoming_packet_buffer, rcv_len);
+	if (!ping.valid(frame_crc)){
+		return;
+	}
+
+	s_clock_pong pong;
+	memset(&pong, 0, sizeof(s_clock_pong));
+	pong.type = TRANSMITTER_FRAME_CLOCK_PONG;
+	pong.server_tx_us = ping->server_tx_us;
+	pong.device_rx_us = device_rx_us;
+	udp.beginPacket(server_address, server_port);
+	pong.device_tx_us = micros();
+	protocol_seal(pong, frame_crc);
+	udp.write((const uint8_t*)&pong, sizeof(s_clock_pong));
+	udp.endPacket();
+}
+
+int build_raw_frame(void){
+	//packs the newest sample of all channels (current_channels) with their ADC values into raw_buffer
+	const s_transmitter_channels &channels(current_channels);
+
+	//built in place, the frame structs are packed
+	s_transmitter_raw_header *header = (s_transmitter_raw_header *)raw_buffer;
+	header->type = TRANSMITTER_FRAME_STATE_RAW;
+	header->channel_count = CHANNEL_COUNT;
+	header->in_button = channels.in_button;
+	header->sequence = telemetry_sequence++;
+	header->timestamp_us = channels.timestamp_us;
+	header->battery_voltage_mv = channels.battery_voltage_mv;
+	header->reserved = 0;
+
+	s_transmitter_raw_value *value = (s_transmitter_raw_value *)(raw_buffer + sizeof(s_transmitter_raw_header));
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++, value++){
+		value->raw = channels.raw[channel];
+		value->in = channels.in[channel];
+		value->out = channels.out[channel];
+	}
+
+	return protocol_seal_table<s_transmitter_raw_header>(raw_buffer, CHANNEL_COUNT, frame_crc);
+}
+
+void receive_blackbox_request(const uint8_t *incoming_packet_buffer, int rcv_len){
+	protocol_view<s_blackbox_request> request(incoming_packet_buffer, rcv_len);
+	if (!request.valid(frame_crc)){
+		return;
+	}
+	if (request->flags & BLACKBOX_REQUEST_RELEASE){
+		blackbox_release();
+		blackbox_dumping = false;
+		blackbox_requested_chunk = -1;
+		return;
+	}
+	if ((request->flags & BLACKBOX_REQUEST_NEW) || !blackbox_dumping){
+		//newest records, the HAL records until it sees the freeze
+		blackbox_release();
+		blackbox_freeze();
+		blackbox_dumping = true;
+		blackbox_dump_id++;
+	}
+	blackbox_last_request_millis = millis();
+	blackbox_requested_chunk = request->chunk;
+}
+
+void send_blackbox_chunk(void){
+	uint32_t count;
+	if (blackbox_requested_chunk < 0 || !blackbox_frozen(count)){
+		return;
+	}
+	//a chunk holds whole HAL loops
+	uint32_t records = count < BLACKBOX_RECORDS ? count : BLACKBOX_RECORDS;
+	uint32_t records_per_chunk = BLACKBOX_CHUNK_MAX_ENTRIES / CHANNEL_COUNT;
+	uint32_t chunk_count = (records + records_per_chunk - 1) / records_per_chunk;
+	uint32_t chunk = blackbox_requested_chunk;
+	blackbox_requested_chunk = -1;
+
+	uint32_t first_record = count - records + chunk * records_per_chunk;
+	uint32_t chunk_records = 0;
+	if (chunk < chunk_count){
+		chunk_records = count - first_record < records_per_chunk ? count - first_record : records_per_chunk;
+	}
+
+	//built in place, the frame structs are packed
+	s_blackbox_chunk_header *header = (s_blackbox_chunk_header *)blackbox_buffer;
+	header->type = TRANSMITTER_FRAME_BLACKBOX_CHUNK;
+	header->entry_count = chunk_records * CHANNEL_COUNT;
+	header->chunk = chunk;
+	header->chunk_count = chunk_count;
+	header->channel_count = CHANNEL_COUNT;
+	header->reserved = 0;
+	header->dump_id = blackbox_dump_id;
+
+	s_blackbox_entry *entry = (s_blackbox_entry *)(blackbox_buffer + sizeof(s_blackbox_chunk_header));
+	for (uint32_t i = 0; i < chunk_records; i++){
+		const s_blackbox_record &record(blackbox_get(first_record + i));
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++, entry++){
+			entry->timestamp_us = record.timestamp_us;
+			entry->channel = channel;
+			entry->flags = record.flags;
+			entry->raw = record.raw[channel];
+			entry->filtered = record.filtered[channel];
+			entry->normalized = record.normalized[channel];
+			entry->out = record.out[channel];
+		}
+	}
+
+	int chunk_len = protocol_seal_table<s_blackbox_chunk_header>(blackbox_buffer, header->entry_count, frame_crc);
+	udp.beginPacket(server_address, server_port);
+	udp.write(blackbox_buffer, chunk_len);
+	udp.endPacket();
+}
+
+void send_loop_diagnostics(const s_loop_diagnostics &comm_window){
+	s_transmitter_diagnostics diagnostics;
+	memset(&diagnostics, 0, sizeof(s_transmitter_diagnostics));
+	diagnostics.type = TRANSMITTER_FRAME_DIAGNOSTICS;
+	//newest window of the HAL, zero until its first one completed
+	hal_loop_diagnostics.read(diagnostics.hal);
+	diagnostics.comm = comm_window;
+	diagnostics.timestamp_us = micros();
+	protocol_seal(diagnostics, frame_crc);
+	udp.beginPacket(server_address, server_port);
+	udp.write((const uint8_t*)&diagnostics, sizeof(s_transmitter_diagnostics));
+	udp.endPacket();
+}
+
+void receive_telemetry_config(const uint8_t *incoming_packet_buffer, int rcv_len){
+	protocol_view<s_telemetry_config> config(incoming_packet_buffer, rcv_len);
+	if (!config.valid(frame_crc)){
+		return;
+	}
+	//I dont trust you either...
+	if (config->packets_per_second < 1 || config->packets_per_second > 500 || config->mode > TELEMETRY_MODE_ON_CHANGE){
+		return;
+	}
+	telemetry_delay_ms = 1000 / config->packets_per_second;
+	telemetry_mode = config->mode;
+	telemetry_heartbeat_ms = config->heartbeat_ms;
+	telemetry_deadband = config->deadband;
+	telemetry_raw = (config->flags & TELEMETRY_FLAG_RAW_ADC) != 0;
+}
+
+bool value_moved(uint8_t now, uint8_t sent){
+	return (now > sent ? now - sent : sent - now) > telemetry_deadband;
+}
+
+bool raw_moved(uint16_t now, uint16_t sent){
+	//the deadband is scaled from 8 to 12 bit
+	return (now > sent ? now - sent : sent - now) > (telemetry_deadband << 4);
+}
+
+bool telemetry_due(void){
+	//periodic mode sends every time, send-on-change only on changes beyond the deadband or when the heartbeat expires
+	if (telemetry_mode != TELEMETRY_MODE_ON_CHANGE){
+		return true;
+	}
+	if (last_telemetry_millis + telemetry_heartbeat_ms <= millis()){
+		return true;
+	}
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+		if (value_moved(current_channels.in[channel], last_sent_channels.in[channel])
+			|| value_moved(current_channels.out[channel], last_sent_channels.out[channel])){
+			return true;
+		}
+		//raw values move before the transmitter is calibrated
+		if (telemetry_raw && raw_moved(current_channels.raw[channel], last_sent_channels.raw[channel])){
+			return true;
+		}
+	}
+	return current_channels.in_button != last_sent_channels.in_button;
+}
 
 void TASK_comm_run(void *param){
 	int packet_size = 0;
-	uint64_t last_send_packet_millis = millis();
-	uint64_t last_millis = millis();
+	//deadline of the next live data packet, advanced by telemetry_delay_ms so the rate does not drift
+	uint64_t next_send_packet_millis = millis();
+
+	s_loop_timer loop_timer;
+	s_loop_diagnostics completed_window;
+	loop_timer_init(loop_timer, COMM_LOOP_PERIOD_MS, LOOP_STATS_WINDOW_MS);
 
 	while (true){
+		loop_timer_begin(loop_timer);
 
-		packet_size = udp.parsePacket(); //returns 0 in case there is none...
-		if (packet_size != 0)
+		//drain every pending datagram, a burst queued in the socket must not be applied one tick apart
+		//overrides are collected and only the newest is applied afterwards
+		int drained_packets = 0;
+		while (drained_packets < INCOMING_PACKET_DRAIN_MAX && (packet_size = udp.parsePacket()) > 0) //returns 0 in case there is none, so the size is never negative below
 		{
+			drained_packets++;
+			uint32_t packet_rx_us = micros();
 			// receive incoming UDP packets
 			//Serial.println("New Packet...");
-			if (packet_size > INCOMING_PACKET_BUFSIZE){
+			if ((size_t)packet_size > INCOMING_PACKET_BUFSIZE){
 				char incoming_packet_buffer[INCOMING_PACKET_BUFSIZE];
 				//this is something that obviously must be an error - discard!
 				while (0 != udp.readBytes(incoming_packet_buffer, INCOMING_PACKET_BUFSIZE));
@@ -125,59 +519,110 @@ void TASK_comm_run(void *param){
 
 			}
 			else{
-				//seems to be a new packet from the master...
-				s_transmitter_control_packet inc_packet;
-				memset(&inc_packet, 0, sizeof(s_transmitter_control_packet));
-				//bad bad and ugly, but maybe it will work...
-				int rcv_len = udp.read((char *)&inc_packet, sizeof(s_transmitter_control_packet));
-				uint8_t steer_received = inc_packet.out_steer;
-				uint8_t throttle_received = inc_packet.out_throttle;
-				uint32_t crc_received = inc_packet.CRC;
-				crc.reset();
-				uint32_t crc_calculated = crc.calculate(&inc_packet, 2);
-
-				//Serial.printf("S: %d / T: %d (%u/%u)\r\n", steer_received, throttle_received, crc_received, crc_calculated);
-
-				if (crc_received == crc_calculated){
-					transmitter_output_override.ready = false; //semaphore, 8 bit shall be atomic... Only necessary for millis, therefore not this important...
-					transmitter_output_override.out_steer = steer_received;
-					transmitter_output_override.out_throttle = throttle_received;
-					transmitter_output_override.CRC = crc_received;
-					transmitter_output_override.millis_last_update = millis();
-					transmitter_output_override.ready = true;
+				uint8_t incoming_packet_buffer[INCOMING_PACKET_BUFSIZE];
+				memset(incoming_packet_buffer, 0, INCOMING_PACKET_BUFSIZE);
+				int rcv_len = udp.read((char *)incoming_packet_buffer, INCOMING_PACKET_BUFSIZE);
+
+				//the legacy control packet carries no frame type, it is recognized by its size
+				if (rcv_len == protocol_frame<s_transmitter_control_packet>::size){
+					receive_control_packet(incoming_packet_buffer, rcv_len);
 				}
-				else{
-					//crc error - zero struct - also sets ready to false :)
-					Serial.println("CRC ERROR");
-					Serial.printf("R: %u / C: %u\r\n", crc_received, crc_calculated);
-					memset((void *)&transmitter_output_override, 0, sizeof(s_transmitter_override));
+				else if (rcv_len > 0 && incoming_packet_buffer[0] == TRANSMITTER_FRAME_CONTROL_V2){
+					receive_control_packet_v2(incoming_packet_buffer, rcv_len);
+				}
+				else if (rcv_len > 0 && incoming_packet_buffer[0] == TRANSMITTER_FRAME_GROUP_OVERRIDE){
+					receive_group_override(incoming_packet_buffer, rcv_len);
+				}
+				else if (rcv_len > 0 && incoming_packet_buffer[0] == TRANSMITTER_FRAME_CLOCK_PING){
+					receive_clock_ping(incoming_packet_buffer, rcv_len, packet_rx_us);
+				}
+				else if (rcv_len > 0 && incoming_packet_buffer[0] == TRANSMITTER_FRAME_TELEMETRY_CONFIG){
+					receive_telemetry_config(incoming_packet_buffer, rcv_len);
+				}
+				else if (rcv_len > 0 && incoming_packet_buffer[0] == TRANSMITTER_FRAME_BLACKBOX_REQUEST){
+					receive_blackbox_request(incoming_packet_buffer, rcv_len);
 				}
-
 			}
+		}
+		if (pending_override.valid){
+			apply_override(pending_override.out_steer, pending_override.out_throttle, pending_override.CRC);
+			pending_override.valid = false;
+		}
 
-
+		//black box dump, on demand of the server
+		if (blackbox_dumping){
+			if (blackbox_last_request_millis + BLACKBOX_DUMP_TIMEOUT_MS < millis()){
+				//server went away mid dump
+				blackbox_release();
+				blackbox_dumping = false;
+				blackbox_requested_chunk = -1;
+			}
+			else if (connected){
+				send_blackbox_chunk();
+			}
 		}
 
-		//send packet every PACKET_DELAY_MS milliseconds
-		if (last_send_packet_millis + PACKET_DELAY_MS <= millis()){
-			if (connected){
+		//send packet every telemetry_delay_ms milliseconds (PACKET_DELAY_MS unless configured by the server)
+		if (next_send_packet_millis <= millis()){
+			next_send_packet_millis += telemetry_delay_ms;
+			//more than a period behind (stalled task, rate changed by the server): skip instead of bursting
+			if (next_send_packet_millis <= millis()){
+				next_send_packet_millis = millis() + telemetry_delay_ms;
+			}
+			//one consistent state for the whole tick, the HAL keeps writing meanwhile
+			transmitter_state.read(current_state);
+			transmitter_channels.read(current_channels);
+			if (connected && telemetry_due()){
+				last_telemetry_millis = millis();
+				last_sent_channels = current_channels;
+
 				//Send a packet
 				udp.beginPacket(server_address, server_port);
 
-				//copy state in transmission packet, omitting CRC
-				memcpy(&ts_packet, (const void*)&transmitter_state, sizeof(s_transmitter_state));
-				//calculate CRC
-				crc.reset();
-				//Attention! CRC is calculated using the size -4 to omit crc itself being adressed for calculation
-				ts_packet.CRC = crc.calculate((const void*)&ts_packet, sizeof(s_transmitter_state_packet) - 4);
-				udp.write((const uint8_t*)&ts_packet, sizeof(s_transmitter_state_packet));
+				if (telemetry_raw){
+					//calibrated on the server
+					int raw_len = build_raw_frame();
+					udp.write(raw_buffer, raw_len);
+				}
+				else{
+#if TELEMETRY_PROTOCOL_VERSION >= 3
+					int channels_len = build_channels_frame();
+					udp.write(channels_buffer, channels_len);
+#elif TELEMETRY_PROTOCOL_VERSION >= 2 && TELEMETRY_BATCH_SIZE > 1
+					int batch_len = build_batch_frame();
+					if (batch_len > 0){
+						udp.write(batch_buffer, batch_len);
+					}
+#elif TELEMETRY_PROTOCOL_VERSION >= 2
+					ts_packet_v2.type = TRANSMITTER_FRAME_STATE_V2;
+					memset(ts_packet_v2.reserved, 0, sizeof(ts_packet_v2.reserved));
+					ts_packet_v2.sequence = telemetry_sequence++;
+					ts_packet_v2.timestamp_us = micros();
+					ts_packet_v2.state = current_state;
+					//CRC over everything in front of it
+					protocol_seal(ts_packet_v2, frame_crc);
+					udp.write((const uint8_t*)&ts_packet_v2, sizeof(s_transmitter_state_packet_v2));
+#else
+					//copy state in transmission packet, omitting CRC
+					memcpy(&ts_packet, &current_state, sizeof(s_transmitter_state));
+					//calculate CRC, over everything in front of it
+					protocol_seal(ts_packet, frame_crc);
+					udp.write((const uint8_t*)&ts_packet, sizeof(s_transmitter_state_packet));
+#endif
+				}
 				udp.endPacket();
 				udp.flush();
 			}
 		}
 
-		vTaskDelay(portTICK_PERIOD_MS);
-
+		//sleep until the next deadline
+		if (loop_timer_wait(loop_timer, completed_window)){
+#ifdef SEND_LOOP_DIAGNOSTICS
+			if (connected){
+				send_loop_diagnostics(completed_window);
+			}
+#endif
+		}
 	}
 	//unreachable!
 
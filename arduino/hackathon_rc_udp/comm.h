@@ -7,6 +7,8 @@
 #include <WiFiUdp.h>
 
 #include "Arduino.h"
+#include "transmitter_protocol.h"
+#include "triple_buffer.h"
 
 //master override data
 struct s_transmitter_override{
@@ -14,17 +16,20 @@ struct s_transmitter_override{
 	uint8_t out_steer;
 	uint64_t millis_last_update;
 	uint32_t CRC;
-	uint8_t ready;
+	uint8_t ready; //false until the first override, and after a broken one
 } __attribute__((packed));
 
-struct s_transmitter_control_packet{
-	uint8_t out_throttle;
-	uint8_t out_steer;
-	uint32_t CRC;
-} __attribute__((packed));
-
-//master updates
-extern volatile s_transmitter_override transmitter_output_override;
+//override packets received and dropped by the comm task
+struct s_control_stats{
+	uint32_t received; //valid override packets
+	uint32_t superseded; //valid, but a newer one arrived within the same drain of the socket
+	uint32_t stale; //sequence number not newer than the last one (reordered or duplicate)
+	uint32_t crc_errors;
+};
+
+//master updates, written by the comm task, read by the HAL
+extern triple_buffer<s_transmitter_override> transmitter_output_override;
+extern volatile s_control_stats control_stats;
 
 int init_comm(const char * ssid, const char * pwd, const char *server_ip, uint16_t server_port, uint16_t listen_port);
 void start_comm(void);
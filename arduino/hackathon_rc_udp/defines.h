@@ -11,6 +11,8 @@
 
 #include <inttypes.h>
 
+#include "transmitter_protocol.h"
+
 //IO pin mapping - DO NOT CHANGE until you really know what you do...
 #define THROTTLE_SENSE_PIN			35
 #define THROTTLE_CONTROL_PIN		26
@@ -22,25 +24,47 @@
 
 #define BATTERY_VOLTAGE_SENSE	36
 
+//analog channels run by the HAL, one row each in channel_table (channels.cpp)
+//more than throttle and steering need TELEMETRY_PROTOCOL_VERSION 3 to reach the server
+#define CHANNEL_COUNT			2
+
 //calibration minimum offset from senter value to begin transmitting data
 #define MINIMAL_ACCEPTED_CALIBRATION_RANGE	500
 
-//analog out basevalues
-#define THROTTLE_MIN_OUT		0
-#define THROTTLE_CNT_OUT		60
-#define THROTTLE_MAX_OUT		255
+//a usable calibration is stored and restored on boot, stored again when the range grew
+//at most every CALIBRATION_SAVE_INTERVAL_MS, flash has limited write cycles
+#define CALIBRATION_SAVE_INTERVAL_MS	30000
 
-#define STEER_MIN_OUT		0
-#define STEER_CNT_OUT		64
-#define STEER_MAX_OUT		128
+//boot waits for the transmitter inputs to settle instead of a fixed time:
+//settled once ADC_SETTLE_SAMPLES samples (ADC_SETTLE_INTERVAL_MS apart) of every channel are within ADC_SETTLE_TOLERANCE
+#define ADC_SETTLE_INTERVAL_MS		5
+#define ADC_SETTLE_SAMPLES			10
+#define ADC_SETTLE_TOLERANCE		24
+//give up waiting after this long and go on, the former fixed boot delay
+#define ADC_SETTLE_TIMEOUT_MS		3000
 
-//normalized values
-#define NORMALIZED_MIN_OUT		0
-#define NORMALIZED_CNT_OUT		UINT8_MAX / 2
-#define NORMALIZED_MAX_OUT		UINT8_MAX
+//analog out basevalues, the server predicts the DAC values from them (transmitter_protocol.h)
+#define THROTTLE_MIN_OUT		TRANSMITTER_THROTTLE_MIN_OUT
+#define THROTTLE_CNT_OUT		TRANSMITTER_THROTTLE_CNT_OUT
+#define THROTTLE_MAX_OUT		TRANSMITTER_THROTTLE_MAX_OUT
+
+#define STEER_MIN_OUT		TRANSMITTER_STEER_MIN_OUT
+#define STEER_CNT_OUT		TRANSMITTER_STEER_CNT_OUT
+#define STEER_MAX_OUT		TRANSMITTER_STEER_MAX_OUT
 
-//low pass filter fraction, (1/FILTER_FRACTION) of the new ADC value is accounted for in the new value
-#define	FILTER_FRACTION		2.0
+//normalized values
+#define NORMALIZED_MIN_OUT		TRANSMITTER_NORMALIZED_MIN_OUT
+#define NORMALIZED_CNT_OUT		TRANSMITTER_NORMALIZED_CNT_OUT
+#define NORMALIZED_MAX_OUT		TRANSMITTER_NORMALIZED_MAX_OUT
+
+//input filter per ADC channel, see filter.h for the types
+//IIR param 1: half of the new ADC value is accounted for in the new value
+#define THROTTLE_FILTER			FILTER_TYPE_IIR
+#define THROTTLE_FILTER_PARAM	1
+#define STEER_FILTER			FILTER_TYPE_IIR
+#define STEER_FILTER_PARAM		1
+//samples taken (10ms apart) for the zero point
+#define FILTER_SETTLE_SAMPLES	16
 
 //array defines
 #define MAP_MIN_INDEX	0
@@ -52,9 +76,35 @@
 //networking stuff
 #define NETWORK_SSID	"hackathonRCAP"
 #define NETWORK_PASS	"geheimpass123"
+//the host build (../host) points these to loopback
+#ifndef MASTER_IP
 #define MASTER_IP		"192.168.0.172"
+#endif
+#ifndef MASTER_PORT
 #define MASTER_PORT		3333
+#endif
+#ifndef LISTEN_PORT
 #define LISTEN_PORT		31337
+#endif
+
+//group overrides are only applied if addressed to this group (or GROUP_ID_ALL)
+#define OVERRIDE_GROUP_ID	0
+//uncomment to receive group overrides via multicast instead of broadcast
+//#define OVERRIDE_MULTICAST_ADDRESS	IPAddress(239, 0, 0, 73)
+
+//live data packet format, 1: legacy state packet, 2: adds sequence number and send timestamp
+//3: all CHANNEL_COUNT channels, one sample per frame
+#define TELEMETRY_PROTOCOL_VERSION	2
+
+//HAL samples sent per live data frame (protocol v2 only), 1 sends single state packets
+#define TELEMETRY_BATCH_SIZE		10
+
+//HAL samples kept for batching, power of two and well above TELEMETRY_BATCH_SIZE
+#define TRANSMITTER_SAMPLE_RING_SIZE	64
+
+#if TELEMETRY_BATCH_SIZE > 32
+#ERROR - batch does not fit the sample ring!
+#endif
 
 //transmission of live data, update rate
 #define PACKETS_PER_SECOND			100
@@ -66,6 +116,24 @@
 //dont touch!
 #define PACKET_DELAY_MS				1000 / PACKETS_PER_SECOND
 
+//live data can be switched to send-on-change by the server at runtime (TELEMETRY_MODE_* in transmitter_protocol.h)
+//defaults for send-on-change: a packet is sent if a value moved more than the deadband or the heartbeat expired
+#define TELEMETRY_HEARTBEAT_MS		500
+#define TELEMETRY_DEADBAND			2
+
+//task loop periods, both run on absolute deadlines (loop_timer.h)
+#define HAL_LOOP_PERIOD_MS			1
+#define COMM_LOOP_PERIOD_MS			1
+//loop timing statistics are collected over windows of this length
+#define LOOP_STATS_WINDOW_MS		1000
+//comment out to stop sending the loop timing to the server once per window
+#define SEND_LOOP_DIAGNOSTICS
+
+//black box, the last BLACKBOX_RECORDS HAL loops are kept in RAM for the server to fetch (~2s at HAL_LOOP_PERIOD_MS 1)
+#define BLACKBOX_RECORDS			2048
+//a dump without a request for this long is abandoned, the HAL records again
+#define BLACKBOX_DUMP_TIMEOUT_MS	2000
+
 //how long is a master overwrite valid in ms?
 #define OVERWRITE_PACKAGE_VALID_MS	500
 
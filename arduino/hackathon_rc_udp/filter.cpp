@@ -0,0 +1,81 @@
+/************************************************************************************/
+// filter.cpp
+// Content: fixed point input filters for the ADC channels
+// IIR with power of two fraction, moving average and median (spike rejection)
+// selected per channel in defines.h
+/************************************************************************************/
+
+#include "filter.h"
+
+void filter_init(s_filter &filter, uint8_t type, uint8_t param, uint16_t initial){
+	filter.type = type;
+	filter.param = param;
+	filter.window_index = 0;
+
+	switch (filter.type){
+	case FILTER_TYPE_IIR:
+		//more than half of the state bits as shift would never move
+		if (filter.param > 15){
+			filter.param = 15;
+		}
+		filter.accumulator = (int32_t)initial << FILTER_IIR_FRACTION_BITS;
+		break;
+	case FILTER_TYPE_MOVING_AVERAGE:
+	case FILTER_TYPE_MEDIAN:
+		if (filter.param < 1){
+			filter.param = 1;
+		}
+		if (filter.param > FILTER_MAX_WINDOW){
+			filter.param = FILTER_MAX_WINDOW;
+		}
+		//median needs a middle element
+		if (filter.type == FILTER_TYPE_MEDIAN && (filter.param % 2) == 0){
+			filter.param--;
+		}
+		for (int i = 0; i < filter.param; i++){
+			filter.window[i] = initial;
+		}
+		filter.accumulator = (int32_t)initial * filter.param;
+		break;
+	default:
+		filter.type = FILTER_TYPE_NONE;
+		filter.accumulator = 0;
+		break;
+	}
+}
+
+static uint16_t filter_median(const s_filter &filter){
+	//insertion sort of a copy, the window is a handful of samples
+	uint16_t sorted[FILTER_MAX_WINDOW];
+	for (int i = 0; i < filter.param; i++){
+		uint16_t value = filter.window[i];
+		int j = i;
+		while (j > 0 && sorted[j - 1] > value){
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = value;
+	}
+	return sorted[filter.param / 2];
+}
+
+uint16_t filter_update(s_filter &filter, uint16_t sample){
+	switch (filter.type){
+	case FILTER_TYPE_IIR:
+		//state += (sample - state) / 2^param, in fixed point
+		filter.accumulator += (((int32_t)sample << FILTER_IIR_FRACTION_BITS) - filter.accumulator) >> filter.param;
+		//rounded
+		return (uint16_t)((filter.accumulator + (1 << (FILTER_IIR_FRACTION_BITS - 1))) >> FILTER_IIR_FRACTION_BITS);
+	case FILTER_TYPE_MOVING_AVERAGE:
+		filter.accumulator += (int32_t)sample - filter.window[filter.window_index];
+		filter.window[filter.window_index] = sample;
+		filter.window_index = (filter.window_index + 1) % filter.param;
+		return (uint16_t)((filter.accumulator + filter.param / 2) / filter.param);
+	case FILTER_TYPE_MEDIAN:
+		filter.window[filter.window_index] = sample;
+		filter.window_index = (filter.window_index + 1) % filter.param;
+		return filter_median(filter);
+	default:
+		return sample;
+	}
+}
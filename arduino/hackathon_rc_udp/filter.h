@@ -0,0 +1,35 @@
+// filter.h
+
+#ifndef _FILTER_h
+#define _FILTER_h
+
+#include <stdint.h>
+
+//input filters for the ADC channels, integer only - the ESP32 has no double precision FPU
+#define FILTER_TYPE_NONE			0
+//first order IIR, param: the new sample is weighted 1 / 2^param
+#define FILTER_TYPE_IIR				1
+//moving average, param: window length
+#define FILTER_TYPE_MOVING_AVERAGE	2
+//median, param: window length (odd), rejects spikes shorter than half the window
+#define FILTER_TYPE_MEDIAN			3
+
+//longest window of moving average and median
+#define FILTER_MAX_WINDOW			16
+//fraction bits of the IIR state, the state does not get stuck below 1 LSB steps
+#define FILTER_IIR_FRACTION_BITS	8
+
+struct s_filter{
+	uint8_t type;
+	uint8_t param;
+	int32_t accumulator; //IIR: state in fixed point, moving average: sum of the window
+	uint16_t window[FILTER_MAX_WINDOW];
+	uint8_t window_index;
+};
+
+//starts the filter settled at initial
+void filter_init(s_filter &filter, uint8_t type, uint8_t param, uint16_t initial);
+//feeds one sample, returns the filtered value
+uint16_t filter_update(s_filter &filter, uint16_t sample);
+
+#endif
@@ -0,0 +1,75 @@
+/************************************************************************************/
+// loop_timer.cpp
+// Content: fixed rate scheduling of the firmware task loops (loop_timer.h)
+// keeps period, jitter, worst case execution time and overruns per statistics window
+/************************************************************************************/
+
+#include "loop_timer.h"
+
+static void loop_timer_new_window(s_loop_timer &timer, uint32_t now_us){
+	timer.window_start_us = now_us;
+	timer.window.window_us = 0;
+	timer.window.iterations = 0;
+	timer.window.min_period_us = UINT32_MAX;
+	timer.window.max_period_us = 0;
+	timer.window.max_execution_us = 0;
+}
+
+void loop_timer_init(s_loop_timer &timer, uint32_t period_ms, uint32_t window_ms){
+	timer.period_ticks = period_ms / portTICK_PERIOD_MS;
+	if (timer.period_ticks == 0){
+		timer.period_ticks = 1;
+	}
+	timer.window_length_us = window_ms * 1000;
+	timer.running = false;
+	timer.overruns = 0;
+	timer.window.period_us = timer.period_ticks * portTICK_PERIOD_MS * 1000;
+	timer.last_wake = xTaskGetTickCount();
+	loop_timer_new_window(timer, micros());
+}
+
+void loop_timer_begin(s_loop_timer &timer){
+	uint32_t now_us = micros();
+	if (timer.running){
+		uint32_t period_us = now_us - timer.begin_us;
+		if (period_us < timer.window.min_period_us){
+			timer.window.min_period_us = period_us;
+		}
+		if (period_us > timer.window.max_period_us){
+			timer.window.max_period_us = period_us;
+		}
+	}
+	else{
+		//the first iteration has no period, the window starts with it
+		loop_timer_new_window(timer, now_us);
+	}
+	timer.running = true;
+	timer.begin_us = now_us;
+	timer.window.iterations++;
+}
+
+bool loop_timer_wait(s_loop_timer &timer, s_loop_diagnostics &completed_window){
+	uint32_t now_us = micros();
+	uint32_t execution_us = now_us - timer.begin_us;
+	if (execution_us > timer.window.max_execution_us){
+		timer.window.max_execution_us = execution_us;
+	}
+
+	bool window_completed = false;
+	if (now_us - timer.window_start_us >= timer.window_length_us){
+		timer.window.window_us = now_us - timer.window_start_us;
+		timer.window.overruns = timer.overruns;
+		completed_window = timer.window;
+		window_completed = true;
+		loop_timer_new_window(timer, now_us);
+	}
+
+	TickType_t now_ticks = xTaskGetTickCount();
+	if ((TickType_t)(now_ticks - timer.last_wake) >= timer.period_ticks){
+		//deadline missed, schedule from now instead of catching up
+		timer.overruns++;
+		timer.last_wake = now_ticks;
+	}
+	vTaskDelayUntil(&timer.last_wake, timer.period_ticks);
+	return window_completed;
+}
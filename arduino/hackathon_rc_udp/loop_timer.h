@@ -0,0 +1,37 @@
+// loop_timer.h
+
+#ifndef _LOOP_TIMER_h
+#define _LOOP_TIMER_h
+
+#include "Arduino.h"
+#include "transmitter_protocol.h"
+
+//fixed rate task loop on absolute deadlines (vTaskDelayUntil), the period does not drift with the work done
+//a loop that misses its deadline is counted as overrun and restarts its schedule from now, so it does not
+//burst to catch up and always sleeps at least one tick (the idle task and watchdog keep running)
+//
+//	loop_timer_init(timer, period_ms, window_ms);
+//	while (true){
+//		loop_timer_begin(timer);
+//		...work...
+//		loop_timer_wait(timer);
+//	}
+struct s_loop_timer{
+	TickType_t last_wake; //deadline of the running iteration
+	TickType_t period_ticks;
+	uint32_t window_length_us;
+	bool running; //an iteration began before, its start time is valid
+	uint32_t begin_us; //micros() when the running iteration began
+	uint32_t window_start_us;
+	s_loop_diagnostics window; //statistics of the window in progress
+	uint32_t overruns;
+};
+
+void loop_timer_init(s_loop_timer &timer, uint32_t period_ms, uint32_t window_ms);
+//start of the loop body
+void loop_timer_begin(s_loop_timer &timer);
+//end of the loop body, sleeps until the next deadline
+//returns true if a statistics window completed, it is copied to completed_window
+bool loop_timer_wait(s_loop_timer &timer, s_loop_diagnostics &completed_window);
+
+#endif
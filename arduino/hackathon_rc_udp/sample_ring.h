@@ -0,0 +1,74 @@
+// sample_ring.h
+
+#ifndef _SAMPLE_RING_h
+#define _SAMPLE_RING_h
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+//hands every value of one task to another task, the reader may be up to SIZE values behind
+//one writer and one reader, neither of them ever waits: the writer overwrites the oldest slot,
+//the reader copies first and checks afterwards which of the copied values were overwritten meanwhile
+//the slots are relaxed atomic words, so a torn copy is a dropped value and not a data race
+template <typename T, uint32_t SIZE>
+class sample_ring{
+public:
+	sample_ring() : written(0) {
+		static_assert((SIZE & (SIZE - 1)) == 0, "sample_ring: SIZE has to be a power of two");
+		for (uint32_t slot = 0; slot < SIZE; slot++){
+			for (uint32_t word = 0; word < SAMPLE_RING_WORDS; word++){
+				this->slots[slot][word].store(0, std::memory_order_relaxed);
+			}
+		}
+	}
+
+	//writer task only
+	void write(const T &value){
+		uint32_t words[SAMPLE_RING_WORDS] = { 0 };
+		memcpy(words, &value, sizeof(T));
+		uint32_t index = this->written.load(std::memory_order_relaxed);
+		//the reader seeing any word of this write also sees that the slot is being overwritten
+		std::atomic_thread_fence(std::memory_order_release);
+		std::atomic<uint32_t> *slot = this->slots[index % SIZE];
+		for (uint32_t word = 0; word < SAMPLE_RING_WORDS; word++){
+			slot[word].store(words[word], std::memory_order_relaxed);
+		}
+		//publish, the value is complete
+		this->written.store(index + 1, std::memory_order_release);
+	}
+
+	//number of values written so far, the newest has index count() - 1
+	uint32_t count() const{
+		return this->written.load(std::memory_order_acquire);
+	}
+
+	//reader task only, copies the values first to first + n - 1 (all below count()) into values
+	//returns how many of the oldest ones were overwritten while copying, they must be dropped
+	uint32_t read(uint32_t first, uint32_t n, T *values) const{
+		for (uint32_t i = 0; i < n; i++){
+			uint32_t words[SAMPLE_RING_WORDS];
+			const std::atomic<uint32_t> *slot = this->slots[(first + i) % SIZE];
+			for (uint32_t word = 0; word < SAMPLE_RING_WORDS; word++){
+				words[word] = slot[word].load(std::memory_order_relaxed);
+			}
+			memcpy(&values[i], words, sizeof(T));
+		}
+		std::atomic_thread_fence(std::memory_order_acquire);
+		//the writer may be overwriting the slot of value written - SIZE right now
+		uint32_t written_after = this->written.load(std::memory_order_relaxed);
+		uint32_t overwritten = 0;
+		while (overwritten < n && written_after - (first + overwritten) >= SIZE){
+			overwritten++;
+		}
+		return overwritten;
+	}
+
+private:
+	static const uint32_t SAMPLE_RING_WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+	std::atomic<uint32_t> slots[SIZE][SAMPLE_RING_WORDS];
+	std::atomic<uint32_t> written; //values written so far, owned by the writer
+};
+
+#endif
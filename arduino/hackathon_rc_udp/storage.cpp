@@ -0,0 +1,45 @@
+/************************************************************************************/
+// storage.cpp
+// Content: persistent key/value store (storage.h) on the NVS partition of the ESP32
+/************************************************************************************/
+
+#include <nvs_flash.h>
+#include <nvs.h>
+
+#include "storage.h"
+
+#define STORAGE_NAMESPACE	"hackathon_rc"
+
+static bool storage_initialized = false;
+
+static bool storage_open(nvs_open_mode mode, nvs_handle *handle){
+	if (!storage_initialized){
+		//the Arduino core may have done this already, a second init is harmless
+		storage_initialized = nvs_flash_init() == ESP_OK;
+	}
+	return storage_initialized && nvs_open(STORAGE_NAMESPACE, mode, handle) == ESP_OK;
+}
+
+bool storage_read(const char *key, void *data, size_t length){
+	nvs_handle handle;
+	if (!storage_open(NVS_READONLY, &handle)){
+		return false;
+	}
+	size_t stored_length = length;
+	esp_err_t err = nvs_get_blob(handle, key, data, &stored_length);
+	nvs_close(handle);
+	return err == ESP_OK && stored_length == length;
+}
+
+bool storage_write(const char *key, const void *data, size_t length){
+	nvs_handle handle;
+	if (!storage_open(NVS_READWRITE, &handle)){
+		return false;
+	}
+	esp_err_t err = nvs_set_blob(handle, key, data, length);
+	if (err == ESP_OK){
+		err = nvs_commit(handle);
+	}
+	nvs_close(handle);
+	return err == ESP_OK;
+}
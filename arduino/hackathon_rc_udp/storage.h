@@ -0,0 +1,18 @@
+// storage.h
+
+#ifndef _STORAGE_h
+#define _STORAGE_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+//small persistent key/value store for settings that survive a reboot
+//NVS on the ESP32 (storage.cpp), a file per key on the host build (../host/host_storage.cpp)
+//keys are at most 15 characters (NVS limit)
+
+//true if exactly length bytes are stored under key, data is undefined otherwise
+bool storage_read(const char *key, void *data, size_t length);
+//true if stored and committed
+bool storage_write(const char *key, const void *data, size_t length);
+
+#endif
@@ -11,30 +11,55 @@
 #include "defines.h"
 #include "transmitter_hal.h"
 #include "comm.h"
+#include "filter.h"
+#include "calibration.h"
+#include "channels.h"
+#include "blackbox.h"
 
-volatile s_transmitter_state transmitter_state;
+triple_buffer<s_transmitter_state> transmitter_state;
+triple_buffer<s_transmitter_channels> transmitter_channels;
+triple_buffer<s_loop_diagnostics> hal_loop_diagnostics;
+sample_ring<s_transmitter_sample, TRANSMITTER_SAMPLE_RING_SIZE> transmitter_samples;
+
+//calibration compiled into lookup tables per channel, rebuilt when min/center/max move
+static s_calibration_lut channel_lut[CHANNEL_COUNT];
 
 void TASK_transmitter_hal_run(void *param);
 
-//LUT based linear interpolation
-//stolen from https://playground.arduino.cc/Main/MultiMap
-//gently modified...
-uint16_t multiMap(uint16_t val, uint16_t* _in, uint16_t* _out, uint8_t size)
-{
-	// take care the value is within range
-	// val = constrain(val, _in[0], _in[size-1]);
-	if (val <= _in[0]) return _out[0];
-	if (val >= _in[size - 1]) return _out[size - 1];
-
-	// search right interval
-	uint8_t pos = 1;  // _in[0] allready tested
-	while (val > _in[pos]) pos++;
-
-	// this will handle all exact "points" in the _in array
-	if (val == _in[pos]) return _out[pos];
-
-	// interpolate in the right segment for the rest
-	return (val - _in[pos - 1]) * (_out[pos] - _out[pos - 1]) / (_in[pos] - _in[pos - 1]) + _out[pos - 1];
+//waits until all channel inputs are steady, see ADC_SETTLE_*
+//returns false if they did not settle within ADC_SETTLE_TIMEOUT_MS
+bool wait_inputs_settled(void){
+	uint64_t start_millis = millis();
+	while (millis() - start_millis < ADC_SETTLE_TIMEOUT_MS){
+		uint16_t min_in[CHANNEL_COUNT];
+		uint16_t max_in[CHANNEL_COUNT];
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			min_in[channel] = UINT16_MAX;
+			max_in[channel] = 0;
+		}
+		for (int i = 0; i < ADC_SETTLE_SAMPLES; i++){
+			for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+				uint16_t in = analogRead(channel_table[channel].sense_pin);
+				if (in < min_in[channel]){
+					min_in[channel] = in;
+				}
+				if (in > max_in[channel]){
+					max_in[channel] = in;
+				}
+			}
+			vTaskDelay(portTICK_PERIOD_MS * ADC_SETTLE_INTERVAL_MS);
+		}
+		bool settled = true;
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			if (max_in[channel] - min_in[channel] > ADC_SETTLE_TOLERANCE){
+				settled = false;
+			}
+		}
+		if (settled){
+			return true;
+		}
+	}
+	return false;
 }
 
 void start_transmitter_hal(void){
@@ -50,181 +75,272 @@ void start_transmitter_hal(void){
 
 void TASK_transmitter_hal_run(void *param){
 	bool calibrated = false;
+	//calibration changed since it was stored
+	bool calibration_dirty = false;
+	uint64_t last_calibration_save_millis = 0;
 	uint64_t last_millis = millis();
 
-	//interpolation maps for throttle...
-	uint16_t map_throttle_in[MAP_SIZE];
-	uint16_t map_throttle_out[MAP_SIZE] = { THROTTLE_MIN_OUT, THROTTLE_CNT_OUT, THROTTLE_MAX_OUT };
-	//...and steering, three point linear interpolation
-	uint16_t map_steer_in[MAP_SIZE];
-	uint16_t map_steer_out[MAP_SIZE] = { STEER_MIN_OUT, STEER_CNT_OUT, STEER_MAX_OUT };
-	uint16_t map_normalized[MAP_SIZE] = { NORMALIZED_MIN_OUT, NORMALIZED_CNT_OUT, NORMALIZED_MAX_OUT };
-
+	//per channel values, one array each, every step below is one loop over the channels (channel_table)
+	//interpolation maps of the inputs, three point linear interpolation
+	uint16_t map_in[CHANNEL_COUNT][MAP_SIZE];
 	//ADC Values read and filtered are put into theese
-	uint16_t in_throttle = 0;
-	uint16_t in_steer = 0;
+	uint16_t raw_in[CHANNEL_COUNT];
+	uint16_t in[CHANNEL_COUNT];
+	s_filter filters[CHANNEL_COUNT];
+	//calibration range seen so far
+	uint16_t min_in[CHANNEL_COUNT];
+	uint16_t max_in[CHANNEL_COUNT];
+	//normalized to uint8_t
+	uint8_t normalized_in[CHANNEL_COUNT];
+	//DAC output values, DAC maps 0-255 to 0-3.3V
+	uint8_t out[CHANNEL_COUNT];
 
 	//button value
 	uint8_t in_button = 0;
 
-	//normalized to uint8_t
-	uint8_t normalized_in_steer = NORMALIZED_CNT_OUT;
-	uint8_t normalized_in_throttle = NORMALIZED_CNT_OUT;
-	uint8_t normalized_override_steer = NORMALIZED_CNT_OUT;
-	uint8_t normalized_override_throttle = NORMALIZED_CNT_OUT;
-
-	uint16_t min_throttle = UINT16_MAX;
-	uint16_t max_throttle = 0;
-	uint16_t min_steer = UINT16_MAX;
-	uint16_t max_steer = 0;
+	//state built by this loop, published to transmitter_state/transmitter_channels once complete
+	s_transmitter_state state = s_transmitter_state();
+	s_transmitter_channels channels = s_transmitter_channels();
+	//newest override from the comm task
+	s_transmitter_override output_override = s_transmitter_override();
+	bool override_active = false;
+	//this loop for the black box
+	s_blackbox_record record;
+
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+		const s_channel_descriptor &descriptor(channel_table[channel]);
+		//out maps are fixed
+		uint16_t map_out[MAP_SIZE];
+		memcpy(map_out, descriptor.map_out, sizeof(map_out));
+		calibration_build_out(channel_lut[channel], map_out, descriptor.override_min, descriptor.override_max);
+
+		in[channel] = 0;
+		min_in[channel] = UINT16_MAX;
+		max_in[channel] = 0;
+		normalized_in[channel] = NORMALIZED_CNT_OUT;
+		out[channel] = descriptor.map_out[MAP_CENTER_INDEX];
+		if (!descriptor.calibrate){
+			map_in[channel][MAP_MIN_INDEX] = 0;
+			map_in[channel][MAP_CENTER_INDEX] = CALIBRATION_ADC_SIZE / 2;
+			map_in[channel][MAP_MAX_INDEX] = CALIBRATION_ADC_SIZE - 1;
+		}
+	}
 
 	//ADC analog resolution to maximum HW supported (ESP32)
 	analogReadResolution(12);
 
-	//DAC output values, DAC maps 0-255 to 0-3.3V
-	uint8_t out_throttle = THROTTLE_CNT_OUT;
-	uint8_t out_steer = STEER_CNT_OUT;
-
 	//pin settings, io configuration for input/output/dac/adc
-	pinMode(THROTTLE_SENSE_PIN, INPUT);
-	pinMode(STEERING_SENSE_PIN, INPUT);
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+		pinMode(channel_table[channel].sense_pin, INPUT);
+		if (channel_table[channel].control_pin != CHANNEL_NO_CONTROL_PIN){
+			pinMode(channel_table[channel].control_pin, OUTPUT);
+		}
+	}
 	pinMode(BUTTON_SENSE_PIN, INPUT);
 
-	pinMode(THROTTLE_CONTROL_PIN, OUTPUT);
-	pinMode(STEERING_CONTROL_PIN, OUTPUT);
-
 	pinMode(BATTERY_VOLTAGE_SENSE, INPUT);
 
 	pinMode(TRANSMITTER_POWER_ENABLE_PIN, OUTPUT);
 	digitalWrite(TRANSMITTER_POWER_ENABLE_PIN, 0);
 
-	//just send the defined mid-level to both dacs until they are calibrated
-	dacWrite(STEERING_CONTROL_PIN, STEER_CNT_OUT);
-	dacWrite(THROTTLE_CONTROL_PIN, THROTTLE_CNT_OUT);
+	//just send the defined mid-level to all dacs until they are calibrated
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+		if (channel_table[channel].control_pin != CHANNEL_NO_CONTROL_PIN){
+			dacWrite(channel_table[channel].control_pin, out[channel]);
+		}
+	}
 
-	//wait for output settling (much too long, but very safe)
-	vTaskDelay(portTICK_PERIOD_MS * 1000);
+	//wait for output settling, the DAC takes microseconds
+	vTaskDelay(portTICK_PERIOD_MS * 10);
 
 	//enable transmitter
 	digitalWrite(TRANSMITTER_POWER_ENABLE_PIN, 1);
 
-	//wait 2 seconds for transmitter to adapt the sent mid-levels
-	vTaskDelay(portTICK_PERIOD_MS * 2000);
-
-	//start reading input values
-	in_throttle = analogRead(THROTTLE_SENSE_PIN);
-	in_steer = analogRead(STEERING_SENSE_PIN);
-
+	//the transmitter adapts the sent mid-levels, wait until its outputs are steady
 	//if transmitter is switched off, input values are zero/close to zero
 	//wait until transmitter is switched on to continue
-	while (in_throttle + in_steer < 10){
-		vTaskDelay(portTICK_PERIOD_MS * 1000);
-		in_throttle = analogRead(THROTTLE_SENSE_PIN);
-		in_steer = analogRead(STEERING_SENSE_PIN);
+	while (true){
+		if (!wait_inputs_settled()){
+			Serial.print("Transmitter inputs did not settle, going on anyway\r\n");
+		}
+		uint32_t in_sum = 0;
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			in[channel] = analogRead(channel_table[channel].sense_pin);
+			in_sum += in[channel];
+		}
+		if (in_sum >= 10){
+			break;
+		}
 		Serial.print("Transmitter is switched off, waiting...\r\n");
+		vTaskDelay(portTICK_PERIOD_MS * 1000);
 	}
 
-	//filtered value for zero point
-	for (int i = 0; i < (FILTER_FRACTION * FILTER_FRACTION); i++){
-		in_throttle = in_throttle + (((double)analogRead(THROTTLE_SENSE_PIN) - (double)in_throttle) / FILTER_FRACTION);
-		in_steer = in_steer + (((double)analogRead(STEERING_SENSE_PIN) - (double)in_steer) / FILTER_FRACTION);
-		vTaskDelay(portTICK_PERIOD_MS * 10);
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+		filter_init(filters[channel], channel_table[channel].filter_type, channel_table[channel].filter_param, in[channel]);
 	}
-	//now we have a center value
-	map_throttle_in[MAP_CENTER_INDEX] = in_throttle;
-	map_steer_in[MAP_CENTER_INDEX] = in_steer;
 
-	while (true){
-		//first read live values, filter them by FILTER_FRACTION
-		in_throttle = in_throttle + (((double)analogRead(THROTTLE_SENSE_PIN) - (double)in_throttle) / FILTER_FRACTION);
-		in_steer = in_steer + (((double)analogRead(STEERING_SENSE_PIN) - (double)in_steer) / FILTER_FRACTION);
-
-		//read button state as boolean
-		in_button = digitalRead(BUTTON_SENSE_PIN) != 0;
-
-		//continous calibration
-			if (in_throttle < min_throttle){
-				min_throttle = in_throttle;
-				map_throttle_in[MAP_MIN_INDEX] = min_throttle;
+	if (calibration_restore(map_in)){
+		//the sticks may be anywhere after a brownout, the stored center is used instead of the current position
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			if (channel_table[channel].calibrate){
+				min_in[channel] = map_in[channel][MAP_MIN_INDEX];
+				max_in[channel] = map_in[channel][MAP_MAX_INDEX];
 			}
-			if (in_throttle > max_throttle){
-				max_throttle = in_throttle;
-				map_throttle_in[MAP_MAX_INDEX] = max_throttle;
+		}
+		calibrated = true;
+		Serial.printf("Calibration restored\r\n");
+	}
+	else{
+		//filtered value for zero point
+		for (int i = 0; i < FILTER_SETTLE_SAMPLES; i++){
+			for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+				in[channel] = filter_update(filters[channel], analogRead(channel_table[channel].sense_pin));
+			}
+			vTaskDelay(portTICK_PERIOD_MS * 10);
+		}
+		//now we have a center value, the range grows from there
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			if (channel_table[channel].calibrate){
+				map_in[channel][MAP_MIN_INDEX] = in[channel];
+				map_in[channel][MAP_CENTER_INDEX] = in[channel];
+				map_in[channel][MAP_MAX_INDEX] = in[channel];
 			}
+		}
+	}
 
-			if (in_steer < min_steer){
-				min_steer = in_steer;
-				map_steer_in[MAP_MIN_INDEX] = min_steer;
+	//the control loop runs on fixed deadlines from here on
+	s_loop_timer loop_timer;
+	s_loop_diagnostics completed_window;
+	loop_timer_init(loop_timer, HAL_LOOP_PERIOD_MS, LOOP_STATS_WINDOW_MS);
+
+	while (true){
+		loop_timer_begin(loop_timer);
+
+		//first read live values, filter them per channel, continous calibration
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			raw_in[channel] = analogRead(channel_table[channel].sense_pin);
+			in[channel] = filter_update(filters[channel], raw_in[channel]);
+			if (!channel_table[channel].calibrate){
+				continue;
 			}
-			if (in_steer > max_steer){
-				max_steer = in_steer;
-				map_steer_in[MAP_MAX_INDEX] = max_steer;
+			if (in[channel] < min_in[channel]){
+				min_in[channel] = in[channel];
+				map_in[channel][MAP_MIN_INDEX] = in[channel];
+				calibration_dirty = true;
 			}
+			if (in[channel] > max_in[channel]){
+				max_in[channel] = in[channel];
+				map_in[channel][MAP_MAX_INDEX] = in[channel];
+				calibration_dirty = true;
+			}
+		}
+
+		//read button state as boolean
+		in_button = digitalRead(BUTTON_SENSE_PIN) != 0;
 
 		//calibrate is false until min value is MINIMAL_ACCEPTED_CALIBRATION_RANGE
 		//lower than center value, max value is MINIMAL_ACCEPTED_CALIBRATION_RANGE higher than center value
 		//center value is MAP_CENTER_INDEX
-		if (
-			min_throttle + MINIMAL_ACCEPTED_CALIBRATION_RANGE < map_throttle_in[MAP_CENTER_INDEX]
-			&& max_throttle - MINIMAL_ACCEPTED_CALIBRATION_RANGE > map_throttle_in[MAP_CENTER_INDEX]
-			&& min_steer + MINIMAL_ACCEPTED_CALIBRATION_RANGE < map_steer_in[MAP_CENTER_INDEX]
-			&& max_steer - MINIMAL_ACCEPTED_CALIBRATION_RANGE > map_steer_in[MAP_CENTER_INDEX]
-			&& !calibrated
-			){
+		if (!calibrated && calibration_usable(map_in)){
 			calibrated = true;
 			Serial.printf("Calibration minimum reached\r\n");
 		}
 
+		//store a new or grown calibration, so the next boot does not need one
+		if (
+			calibrated
+			&& calibration_dirty
+			&& (last_calibration_save_millis == 0 || last_calibration_save_millis + CALIBRATION_SAVE_INTERVAL_MS < millis())
+			){
+			last_calibration_save_millis = millis();
+			calibration_dirty = false;
+			if (!calibration_persist(map_in)){
+				Serial.printf("Storing calibration failed\r\n");
+			}
+		}
+
 		if (calibrated){
 			//live updates from finished calibration on...
-			
-			//linear mapping of input values, based on three point LUT
-			normalized_in_steer = multiMap(in_steer, map_steer_in, map_normalized, MAP_SIZE);
-			normalized_in_throttle = multiMap(in_throttle, map_throttle_in, map_normalized, MAP_SIZE);
 
 			//first check if we need to overwrite the output
-			//is semaphore ready & packet not too old
-
-			if (
-				transmitter_output_override.ready == true
-				&& transmitter_output_override.millis_last_update + OVERWRITE_PACKAGE_VALID_MS > millis()
-				){
-				//A live packet from master is here, override output
-				//replace values by master values
-				normalized_override_steer = transmitter_output_override.out_steer;
-				normalized_override_throttle = map(transmitter_output_override.out_throttle, 0, 255, THROTTLE_MIN_OUT, THROTTLE_MAX_OUT);
-				
-				//de-normalize values to real out values
-				out_steer = multiMap(normalized_override_steer, map_normalized, map_steer_out, MAP_SIZE);
-				out_throttle = multiMap(normalized_override_throttle, map_normalized, map_throttle_out, MAP_SIZE);
-			}
-			else{
-				//use the Transmitters ADC values for controlling the car
-				//de-normalize ADC values to real out values
-				out_steer = multiMap(normalized_in_steer, map_normalized, map_steer_out, MAP_SIZE);
-				out_throttle = multiMap(normalized_in_throttle, map_normalized, map_throttle_out, MAP_SIZE);
+			//is an override there & packet not too old
+			transmitter_output_override.read(output_override);
+			override_active = output_override.ready == true
+				&& output_override.millis_last_update + OVERWRITE_PACKAGE_VALID_MS > millis();
+
+			for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+				//rebuild the tables where min/max moved, nothing to do if they did not
+				calibration_update_in(channel_lut[channel], map_in[channel]);
+
+				//linear mapping of input values, based on three point LUT
+				normalized_in[channel] = calibration_normalize(channel_lut[channel], in[channel]);
+
+				//A live packet from master is here, override output of throttle and steering
+				//replace values by master values, de-normalized to real out values
+				if (override_active && channel == TRANSMITTER_CHANNEL_THROTTLE){
+					out[channel] = channel_lut[channel].override_to_out[output_override.out_throttle];
+				}
+				else if (override_active && channel == TRANSMITTER_CHANNEL_STEER){
+					out[channel] = channel_lut[channel].override_to_out[output_override.out_steer];
+				}
+				else{
+					//use the Transmitters ADC values for controlling the car
+					//de-normalize ADC values to real out values
+					out[channel] = channel_lut[channel].normalized_to_out[normalized_in[channel]];
+				}
 			}
 
-			//update global transmitter state
-			transmitter_state.in_steer = normalized_in_steer;
-			transmitter_state.in_throttle = normalized_in_throttle;
-			transmitter_state.out_steer = out_steer;
-			transmitter_state.out_throttle = out_throttle;
+			//update transmitter state
+			state.in_throttle = normalized_in[TRANSMITTER_CHANNEL_THROTTLE];
+			state.in_steer = normalized_in[TRANSMITTER_CHANNEL_STEER];
+			state.out_throttle = out[TRANSMITTER_CHANNEL_THROTTLE];
+			state.out_steer = out[TRANSMITTER_CHANNEL_STEER];
+			memcpy(channels.in, normalized_in, sizeof(channels.in));
+			memcpy(channels.out, out, sizeof(channels.out));
 		}
 
 		if (last_millis + 1000 < millis()){
 			last_millis = millis();
 			//transform ADC reading to millivolt
-			transmitter_state.battery_voltage = (3.3 / 4.096) * 2 * analogRead(BATTERY_VOLTAGE_SENSE);
-			//printf("in_steer: %d;in_throttle %d;out_steer: %d; out_throttle: %d\r\n", transmitter_state.in_steer, transmitter_state.in_throttle, transmitter_state.out_steer, transmitter_state.out_throttle);
+			state.battery_voltage_mv = (3.3 / 4.096) * 2 * analogRead(BATTERY_VOLTAGE_SENSE);
+			//printf("in_steer: %d;in_throttle %d;out_steer: %d; out_throttle: %d\r\n", state.in_steer, state.in_throttle, state.out_steer, state.out_throttle);
 		}
 
+		//publish the complete state of this loop to the comm task
+		uint32_t now_us = micros();
+		channels.timestamp_us = now_us;
+		memcpy(channels.raw, in, sizeof(channels.raw));
+		state.in_button = in_button;
+		channels.in_button = state.in_button;
+		channels.battery_voltage_mv = state.battery_voltage_mv;
+		transmitter_state.write(state);
+		transmitter_channels.write(channels);
+
+		//keep every sample for batched telemetry
+		s_transmitter_sample sample;
+		sample.timestamp_us = now_us;
+		sample.state = state;
+		transmitter_samples.write(sample);
+
+		//every loop for post-mortems, skipped while the server fetches the black box
+		record.timestamp_us = now_us;
+		record.flags = (calibrated ? BLACKBOX_FLAG_CALIBRATED : 0) | (override_active ? BLACKBOX_FLAG_OVERRIDE : 0);
+		memcpy(record.raw, raw_in, sizeof(record.raw));
+		memcpy(record.filtered, in, sizeof(record.filtered));
+		memcpy(record.normalized, channels.in, sizeof(record.normalized));
+		memcpy(record.out, channels.out, sizeof(record.out));
+		blackbox_record(record);
+
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			if (channel_table[channel].control_pin != CHANNEL_NO_CONTROL_PIN){
+				dacWrite(channel_table[channel].control_pin, channels.out[channel]);
+			}
+		}
 
-		dacWrite(STEERING_CONTROL_PIN, transmitter_state.out_steer);
-		dacWrite(THROTTLE_CONTROL_PIN, transmitter_state.out_throttle);
-
-			vTaskDelay(portTICK_PERIOD_MS);
-
+		//sleep until the next deadline
+		if (loop_timer_wait(loop_timer, completed_window)){
+			hal_loop_diagnostics.write(completed_window);
+		}
 	}
 	//unreachable!
 	vTaskDelete(NULL); //cleanup for Task
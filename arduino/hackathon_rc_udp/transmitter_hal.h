@@ -5,18 +5,38 @@
 
 #include "Arduino.h"
 #include "defines.h"
+#include "transmitter_protocol.h"
+#include "triple_buffer.h"
+#include "sample_ring.h"
+#include "loop_timer.h"
 
-struct s_transmitter_state{
-	uint8_t in_throttle;
-	uint8_t in_steer;
-	uint16_t in_button;
-	uint8_t out_throttle;
-	uint8_t out_steer;
-	uint16_t battery_voltage;
+//one HAL loop sample of the transmitter state
+struct s_transmitter_sample{
+	uint32_t timestamp_us; //micros() when sampled
+	s_transmitter_state state;
 } __attribute__((packed));
 
+//live state of every analog channel, in channel_table order (channels.h)
+struct s_transmitter_channels{
+	uint32_t timestamp_us; //micros() when sampled
+	uint8_t in[CHANNEL_COUNT]; //normalized
+	uint8_t out[CHANNEL_COUNT];
+	uint16_t raw[CHANNEL_COUNT]; //filtered ADC, also before the calibration
+	uint16_t in_button;
+	uint16_t battery_voltage_mv;
+};
+
 //realtime updated state of transmitter, gets written from transmitter_hal
-extern volatile s_transmitter_state transmitter_state;
+//every HAL loop publishes a complete state, readers get the newest one
+extern triple_buffer<s_transmitter_state> transmitter_state;
+//same loop, all channels - transmitter_state holds throttle and steering of it
+extern triple_buffer<s_transmitter_channels> transmitter_channels;
+
+//every HAL loop sample, for batched telemetry
+extern sample_ring<s_transmitter_sample, TRANSMITTER_SAMPLE_RING_SIZE> transmitter_samples;
+
+//loop timing of the HAL task, published once per LOOP_STATS_WINDOW_MS
+extern triple_buffer<s_loop_diagnostics> hal_loop_diagnostics;
 
 void start_transmitter_hal(void);
 
@@ -0,0 +1,465 @@
+/************************************************************************************/
+// transmitter_protocol.h
+// Content: network protocol between transmitters and server
+// the one definition of every frame, included by the firmware and by the udpserver
+// all frames are packed and little endian, frames other than the legacy state and
+// control packets start with their frame type, every frame ends with the CRC32 over
+// everything in front of it
+/************************************************************************************/
+
+#ifndef _TRANSMITTER_PROTOCOL_h
+#define _TRANSMITTER_PROTOCOL_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+//the frames are sent as they are in memory, both the ESP32 and the x86/ARM servers are little endian
+//a big endian host would need byte swapping in the views below - catch it at compile time
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "transmitter_protocol.h: frames are little endian, this host is not"
+#endif
+#endif
+
+//frame types
+#define TRANSMITTER_FRAME_STATE_V2		0x02
+#define TRANSMITTER_FRAME_STATE_BATCH	0x03
+#define TRANSMITTER_FRAME_STATE_CHANNELS	0x04
+#define TRANSMITTER_FRAME_STATE_RAW		0x05
+#define TRANSMITTER_FRAME_GROUP_OVERRIDE	0x10
+#define TRANSMITTER_FRAME_CONTROL_V2	0x11
+#define TRANSMITTER_FRAME_CLOCK_PING	0x20
+#define TRANSMITTER_FRAME_CLOCK_PONG	0x21
+#define TRANSMITTER_FRAME_TELEMETRY_CONFIG	0x30
+#define TRANSMITTER_FRAME_DIAGNOSTICS	0x40
+#define TRANSMITTER_FRAME_BLACKBOX_REQUEST	0x50
+#define TRANSMITTER_FRAME_BLACKBOX_CHUNK	0x51
+
+//legacy frames have no type byte, they are recognized by their size
+#define TRANSMITTER_FRAME_UNTYPED		-1
+
+//live data transmission modes of the transmitters
+#define TELEMETRY_MODE_PERIODIC		0
+#define TELEMETRY_MODE_ON_CHANGE	1
+//live data flags, raw: filtered 12 bit ADC values of all channels (s_transmitter_raw_header), calibrated on the server
+#define TELEMETRY_FLAG_RAW_ADC		0x01
+
+//batched live data, most samples in one frame
+#define TELEMETRY_BATCH_MAX_SAMPLES	32
+
+//live data of any number of analog channels (protocol v3), most channels in one frame
+//channel 0 is the throttle, channel 1 the steering, the ones behind are auxiliary inputs
+#define TRANSMITTER_MAX_CHANNELS	16
+#define TRANSMITTER_CHANNEL_THROTTLE	0
+#define TRANSMITTER_CHANNEL_STEER		1
+
+//analog out maps of throttle and steering, normalized value (min, center, max) to DAC value
+//the transmitters echo DAC values and not override values, the server predicts with these maps
+//what an override shows up as (protocol_dac_value) - channel_table of the firmware is built from them
+#define TRANSMITTER_NORMALIZED_MIN_OUT	0
+#define TRANSMITTER_NORMALIZED_CNT_OUT	127
+#define TRANSMITTER_NORMALIZED_MAX_OUT	255
+#define TRANSMITTER_THROTTLE_MIN_OUT	0
+#define TRANSMITTER_THROTTLE_CNT_OUT	60
+#define TRANSMITTER_THROTTLE_MAX_OUT	255
+#define TRANSMITTER_STEER_MIN_OUT		0
+#define TRANSMITTER_STEER_CNT_OUT		64
+#define TRANSMITTER_STEER_MAX_OUT		128
+
+//black box dump, entries per chunk (a chunk stays below the MTU)
+#define BLACKBOX_CHUNK_MAX_ENTRIES	100
+//black box request flags
+#define BLACKBOX_REQUEST_NEW		0x01 //freeze the recording, the chunk is of a new dump
+#define BLACKBOX_REQUEST_RELEASE	0x02 //dump done, the HAL records again - no chunk is sent
+//black box entry flags
+#define BLACKBOX_FLAG_CALIBRATED	0x01
+#define BLACKBOX_FLAG_OVERRIDE		0x02 //out came from an override of the server
+
+//group override addressing every transmitter regardless of its group
+#define GROUP_ID_ALL		0xFF
+#define GROUP_OVERRIDE_MAX_SLOTS	32
+
+
+#pragma pack(push, 1)
+
+//live state of a transmitter, as sampled by the HAL
+struct s_transmitter_state{
+	uint8_t in_throttle;
+	uint8_t in_steer;
+	uint16_t in_button;
+	uint8_t out_throttle;
+	uint8_t out_steer;
+	uint16_t battery_voltage_mv;
+};
+
+//transmitter -> server, live data, protocol v1
+//the transmitter copies s_transmitter_state in front of the CRC, see the asserts below
+struct s_transmitter_state_packet{
+	uint8_t in_throttle;
+	uint8_t in_steer;
+	uint16_t in_button;
+	uint8_t out_throttle;
+	uint8_t out_steer;
+	uint16_t battery_voltage_mv;
+	uint32_t CRC;
+};
+
+//transmitter -> server, live data, protocol v2
+//the sequence number and send timestamp let the server tell loss, reordering and jitter apart
+struct s_transmitter_state_packet_v2{
+	uint8_t type;
+	uint8_t reserved[3];
+	uint32_t sequence;
+	uint32_t timestamp_us; //micros() of the transmitter when sent
+	s_transmitter_state state;
+	uint32_t CRC;
+};
+
+//transmitter -> server, batched live data
+//header, sample_count samples and the CRC32 over header and samples
+struct s_transmitter_batch_header{
+	uint8_t type;
+	uint8_t sample_count;
+	uint16_t send_offset_us; //send time relative to base_timestamp_us
+	uint32_t sequence;
+	uint32_t base_timestamp_us; //micros() of the first sample
+};
+
+struct s_transmitter_batch_sample{
+	uint16_t offset_us; //relative to base_timestamp_us, a batch spans a few HAL ticks only
+	s_transmitter_state state;
+};
+
+//transmitter -> server, live data of all analog channels, protocol v3
+//header, channel_count channels and the CRC32 over header and channels
+struct s_transmitter_channels_header{
+	uint8_t type;
+	uint8_t channel_count;
+	uint16_t in_button;
+	uint32_t sequence;
+	uint32_t timestamp_us; //micros() of the transmitter when sampled
+	uint16_t battery_voltage_mv;
+	uint16_t reserved;
+};
+
+struct s_transmitter_channel_value{
+	uint8_t in; //normalized input
+	uint8_t out; //value sent to the transmitter
+};
+
+//transmitter -> server, live data of all analog channels with the ADC values (TELEMETRY_FLAG_RAW_ADC)
+//header, channel_count channels and the CRC32 over header and channels
+struct s_transmitter_raw_header{
+	uint8_t type;
+	uint8_t channel_count;
+	uint16_t in_button;
+	uint32_t sequence;
+	uint32_t timestamp_us; //micros() of the transmitter when sampled
+	uint16_t battery_voltage_mv;
+	uint16_t reserved;
+};
+
+struct s_transmitter_raw_value{
+	uint16_t raw; //12 bit ADC after the input filter
+	uint8_t in; //normalized by the transmitter, 0 until it is calibrated
+	uint8_t out; //value sent to the transmitter
+};
+
+//server -> transmitter, override data, legacy
+struct s_transmitter_control_packet{
+	uint8_t out_throttle;
+	uint8_t out_steer;
+	uint32_t CRC;
+};
+
+//server -> transmitter, override data with a per transmitter sequence number
+//the transmitter applies only the newest, reordered and duplicate packets are dropped
+struct s_transmitter_control_packet_v2{
+	uint8_t type;
+	uint8_t out_throttle;
+	uint8_t out_steer;
+	uint8_t reserved;
+	uint32_t sequence;
+	uint32_t CRC;
+};
+
+//server -> many transmitters via broadcast/multicast, override data
+//header, slot_count slots and the CRC32 over header and slots
+struct s_group_override_header{
+	uint8_t type;
+	uint8_t group_id;
+	uint8_t slot_count;
+	uint8_t reserved;
+};
+
+struct s_group_override_slot{
+	uint8_t transmitter_id; //last octet of the transmitter ip address
+	uint8_t out_throttle;
+	uint8_t out_steer;
+};
+
+//clock synchronization, the server pings and the transmitter answers with its receive and send time
+struct s_clock_ping{
+	uint8_t type;
+	uint8_t reserved[3];
+	uint64_t server_tx_us;
+	uint32_t CRC;
+};
+
+struct s_clock_pong{
+	uint8_t type;
+	uint8_t reserved[3];
+	uint64_t server_tx_us; //copied from the ping
+	uint32_t device_rx_us; //micros() of the transmitter when the ping arrived
+	uint32_t device_tx_us; //micros() of the transmitter when the pong was sent
+	uint32_t CRC;
+};
+
+//server -> transmitter, runtime configuration of the live data transmission
+struct s_telemetry_config{
+	uint8_t type;
+	uint8_t mode; //TELEMETRY_MODE_PERIODIC or TELEMETRY_MODE_ON_CHANGE
+	uint16_t packets_per_second; //1..500, upper limit in send-on-change mode
+	uint16_t heartbeat_ms; //send-on-change: send at least this often
+	uint8_t deadband; //send-on-change: minimum change of a normalized value
+	uint8_t flags; //TELEMETRY_FLAG_*, zero for older servers
+	uint32_t CRC;
+};
+
+//timing of one firmware loop over a statistics window
+struct s_loop_diagnostics{
+	uint32_t period_us; //nominal period
+	uint32_t window_us; //length of the window
+	uint32_t iterations; //loop iterations within the window, window_us / iterations is the real period
+	uint32_t min_period_us; //shortest start to start time within the window
+	uint32_t max_period_us; //longest start to start time within the window
+	uint32_t max_execution_us; //worst case execution time within the window
+	uint32_t overruns; //since boot, iterations that finished after their deadline
+};
+
+//transmitter -> server, optional, loop timing of the HAL and comm task once per window
+struct s_transmitter_diagnostics{
+	uint8_t type;
+	uint8_t reserved[3];
+	uint32_t timestamp_us; //micros() of the transmitter when sent
+	s_loop_diagnostics hal;
+	s_loop_diagnostics comm;
+	uint32_t CRC;
+};
+
+//server -> transmitter, asks for one chunk of the black box
+//the transmitter answers with the chunk once its HAL stopped recording
+struct s_blackbox_request{
+	uint8_t type;
+	uint8_t flags; //BLACKBOX_REQUEST_*
+	uint16_t chunk;
+	uint32_t CRC;
+};
+
+//transmitter -> server, one chunk of a black box dump, oldest entries first
+//header, entry_count entries and the CRC32 over header and entries
+struct s_blackbox_chunk_header{
+	uint8_t type;
+	uint8_t entry_count; //a chunk holds whole HAL loops, channel_count entries each
+	uint16_t chunk;
+	uint16_t chunk_count; //of the dump, 0 if nothing was recorded yet
+	uint8_t channel_count;
+	uint8_t reserved;
+	uint32_t dump_id; //changes with every dump, chunks of different dumps must not be mixed
+};
+
+//one channel of one HAL loop as recorded
+struct s_blackbox_entry{
+	uint32_t timestamp_us; //micros() of the transmitter
+	uint8_t channel;
+	uint8_t flags; //BLACKBOX_FLAG_*
+	uint16_t raw; //ADC
+	uint16_t filtered; //ADC after the input filter
+	uint8_t normalized;
+	uint8_t out; //value sent to the transmitter
+};
+
+#pragma pack(pop)
+
+
+//compile time description of the frames, sizes and CRC positions are checked right here
+//so firmware and server cannot drift apart unnoticed
+
+//fixed size frames, the CRC is the last field and covers everything in front of it
+template<typename FRAME> struct protocol_frame;
+
+#define PROTOCOL_FRAME(frame_struct, frame_type, frame_size) \
+	template<> struct protocol_frame<frame_struct>{ \
+		static const int type = frame_type; \
+		static const size_t size = frame_size; \
+		static const size_t crc_span = frame_size - sizeof(uint32_t); \
+	}; \
+	static_assert(sizeof(frame_struct) == frame_size, #frame_struct ": size does not match the protocol"); \
+	static_assert(offsetof(frame_struct, CRC) == frame_size - sizeof(uint32_t), #frame_struct ": CRC has to be the last field")
+
+PROTOCOL_FRAME(s_transmitter_state_packet, TRANSMITTER_FRAME_UNTYPED, 12);
+PROTOCOL_FRAME(s_transmitter_state_packet_v2, TRANSMITTER_FRAME_STATE_V2, 24);
+PROTOCOL_FRAME(s_transmitter_control_packet, TRANSMITTER_FRAME_UNTYPED, 6);
+PROTOCOL_FRAME(s_transmitter_control_packet_v2, TRANSMITTER_FRAME_CONTROL_V2, 12);
+PROTOCOL_FRAME(s_clock_ping, TRANSMITTER_FRAME_CLOCK_PING, 16);
+PROTOCOL_FRAME(s_clock_pong, TRANSMITTER_FRAME_CLOCK_PONG, 24);
+PROTOCOL_FRAME(s_telemetry_config, TRANSMITTER_FRAME_TELEMETRY_CONFIG, 12);
+PROTOCOL_FRAME(s_transmitter_diagnostics, TRANSMITTER_FRAME_DIAGNOSTICS, 68);
+PROTOCOL_FRAME(s_blackbox_request, TRANSMITTER_FRAME_BLACKBOX_REQUEST, 8);
+
+//variable size frames, header, entries and the CRC over header and entries
+template<typename HEADER> struct protocol_table_frame;
+
+#define PROTOCOL_TABLE_FRAME(header_struct, entry_struct, frame_type, header_bytes, entry_bytes, entries_max) \
+	template<> struct protocol_table_frame<header_struct>{ \
+		typedef entry_struct entry_type; \
+		static const int type = frame_type; \
+		static const size_t header_size = header_bytes; \
+		static const size_t entry_size = entry_bytes; \
+		static const size_t max_entries = entries_max; \
+		static const size_t max_size = header_bytes + entries_max * entry_bytes + sizeof(uint32_t); \
+		static constexpr size_t crc_span(size_t entries){ return header_bytes + entries * entry_bytes; } \
+		static constexpr size_t size(size_t entries){ return header_bytes + entries * entry_bytes + sizeof(uint32_t); } \
+	}; \
+	static_assert(sizeof(header_struct) == header_bytes, #header_struct ": size does not match the protocol"); \
+	static_assert(sizeof(entry_struct) == entry_bytes, #entry_struct ": size does not match the protocol")
+
+PROTOCOL_TABLE_FRAME(s_transmitter_batch_header, s_transmitter_batch_sample, TRANSMITTER_FRAME_STATE_BATCH, 12, 10, TELEMETRY_BATCH_MAX_SAMPLES);
+PROTOCOL_TABLE_FRAME(s_transmitter_channels_header, s_transmitter_channel_value, TRANSMITTER_FRAME_STATE_CHANNELS, 16, 2, TRANSMITTER_MAX_CHANNELS);
+PROTOCOL_TABLE_FRAME(s_transmitter_raw_header, s_transmitter_raw_value, TRANSMITTER_FRAME_STATE_RAW, 16, 4, TRANSMITTER_MAX_CHANNELS);
+PROTOCOL_TABLE_FRAME(s_blackbox_chunk_header, s_blackbox_entry, TRANSMITTER_FRAME_BLACKBOX_CHUNK, 12, 12, BLACKBOX_CHUNK_MAX_ENTRIES);
+PROTOCOL_TABLE_FRAME(s_group_override_header, s_group_override_slot, TRANSMITTER_FRAME_GROUP_OVERRIDE, 4, 3, GROUP_OVERRIDE_MAX_SLOTS);
+
+//field offsets both sides rely on
+static_assert(sizeof(s_transmitter_state) == 8, "s_transmitter_state: size does not match the protocol");
+static_assert(offsetof(s_transmitter_state_packet, in_throttle) == offsetof(s_transmitter_state, in_throttle)
+	&& offsetof(s_transmitter_state_packet, in_steer) == offsetof(s_transmitter_state, in_steer)
+	&& offsetof(s_transmitter_state_packet, in_button) == offsetof(s_transmitter_state, in_button)
+	&& offsetof(s_transmitter_state_packet, out_throttle) == offsetof(s_transmitter_state, out_throttle)
+	&& offsetof(s_transmitter_state_packet, out_steer) == offsetof(s_transmitter_state, out_steer)
+	&& offsetof(s_transmitter_state_packet, battery_voltage_mv) == offsetof(s_transmitter_state, battery_voltage_mv),
+	"s_transmitter_state_packet: has to start with the layout of s_transmitter_state");
+static_assert(offsetof(s_transmitter_state_packet_v2, sequence) == 4 && offsetof(s_transmitter_state_packet_v2, timestamp_us) == 8
+	&& offsetof(s_transmitter_state_packet_v2, state) == 12, "s_transmitter_state_packet_v2: field offsets do not match the protocol");
+static_assert(offsetof(s_transmitter_batch_header, sequence) == 4 && offsetof(s_transmitter_batch_header, base_timestamp_us) == 8,
+	"s_transmitter_batch_header: field offsets do not match the protocol");
+static_assert(offsetof(s_transmitter_channels_header, sequence) == 4 && offsetof(s_transmitter_channels_header, timestamp_us) == 8
+	&& offsetof(s_transmitter_channels_header, battery_voltage_mv) == 12, "s_transmitter_channels_header: field offsets do not match the protocol");
+static_assert(offsetof(s_transmitter_raw_header, sequence) == 4 && offsetof(s_transmitter_raw_header, timestamp_us) == 8
+	&& offsetof(s_transmitter_raw_header, battery_voltage_mv) == 12, "s_transmitter_raw_header: field offsets do not match the protocol");
+static_assert(offsetof(s_transmitter_raw_value, in) == 2, "s_transmitter_raw_value: field offsets do not match the protocol");
+static_assert(offsetof(s_transmitter_batch_sample, state) == 2, "s_transmitter_batch_sample: field offsets do not match the protocol");
+static_assert(offsetof(s_transmitter_control_packet_v2, out_throttle) == 1 && offsetof(s_transmitter_control_packet_v2, out_steer) == 2
+	&& offsetof(s_transmitter_control_packet_v2, sequence) == 4, "s_transmitter_control_packet_v2: field offsets do not match the protocol");
+static_assert(offsetof(s_clock_ping, server_tx_us) == 4, "s_clock_ping: field offsets do not match the protocol");
+static_assert(offsetof(s_clock_pong, server_tx_us) == 4 && offsetof(s_clock_pong, device_rx_us) == 12
+	&& offsetof(s_clock_pong, device_tx_us) == 16, "s_clock_pong: field offsets do not match the protocol");
+static_assert(offsetof(s_telemetry_config, packets_per_second) == 2 && offsetof(s_telemetry_config, heartbeat_ms) == 4
+	&& offsetof(s_telemetry_config, deadband) == 6 && offsetof(s_telemetry_config, flags) == 7, "s_telemetry_config: field offsets do not match the protocol");
+static_assert(sizeof(s_loop_diagnostics) == 28 && offsetof(s_loop_diagnostics, overruns) == 24, "s_loop_diagnostics: layout does not match the protocol");
+static_assert(offsetof(s_transmitter_diagnostics, timestamp_us) == 4 && offsetof(s_transmitter_diagnostics, hal) == 8
+	&& offsetof(s_transmitter_diagnostics, comm) == 36, "s_transmitter_diagnostics: field offsets do not match the protocol");
+static_assert(offsetof(s_blackbox_request, chunk) == 2, "s_blackbox_request: field offsets do not match the protocol");
+static_assert(offsetof(s_blackbox_chunk_header, chunk_count) == 4 && offsetof(s_blackbox_chunk_header, dump_id) == 8,
+	"s_blackbox_chunk_header: field offsets do not match the protocol");
+static_assert(offsetof(s_blackbox_entry, raw) == 6 && offsetof(s_blackbox_entry, filtered) == 8 && offsetof(s_blackbox_entry, out) == 11,
+	"s_blackbox_entry: field offsets do not match the protocol");
+
+
+//zero copy views on a received datagram, the frame is read in place from the receive buffer
+//the structs are packed, so reading their fields is fine at any alignment
+//CRC_FUNCTION is whatever CRC32 implementation the side has: uint32_t crc_function(const void *data, size_t length)
+
+template<typename FRAME>
+class protocol_view{
+public:
+	protocol_view(const void *buffer, int length) : buffer((const uint8_t *)buffer), length(length) {}
+
+	//size and frame type fit, says nothing about the CRC yet
+	bool matches() const{
+		return this->length == (int)protocol_frame<FRAME>::size
+			&& (protocol_frame<FRAME>::type == TRANSMITTER_FRAME_UNTYPED || this->buffer[0] == protocol_frame<FRAME>::type);
+	}
+
+	template<typename CRC_FUNCTION>
+	bool valid(CRC_FUNCTION crc_function) const{
+		return this->matches() && crc_function(this->buffer, protocol_frame<FRAME>::crc_span) == this->frame()->CRC;
+	}
+
+	const FRAME *frame() const{ return reinterpret_cast<const FRAME *>(this->buffer); }
+	const FRAME *operator->() const{ return this->frame(); }
+
+private:
+	const uint8_t *buffer;
+	int length;
+};
+
+template<typename HEADER>
+class protocol_table_view{
+public:
+	typedef protocol_table_frame<HEADER> layout;
+	typedef typename layout::entry_type entry_type;
+
+	protocol_table_view(const void *buffer, int length) : buffer((const uint8_t *)buffer), length(length) {}
+
+	//room for the header and the frame type fits, the header may be read
+	bool has_header() const{
+		return this->length >= (int)(layout::header_size + sizeof(uint32_t)) && this->buffer[0] == layout::type;
+	}
+
+	//the datagram holds exactly entries entries
+	bool matches(size_t entries) const{
+		return this->has_header() && entries <= layout::max_entries && this->length == (int)layout::size(entries);
+	}
+
+	template<typename CRC_FUNCTION>
+	bool valid(size_t entries, CRC_FUNCTION crc_function) const{
+		return this->matches(entries) && crc_function(this->buffer, layout::crc_span(entries)) == this->crc(entries);
+	}
+
+	const HEADER *header() const{ return reinterpret_cast<const HEADER *>(this->buffer); }
+	const entry_type *entry(size_t index) const{
+		return reinterpret_cast<const entry_type *>(this->buffer + layout::header_size + index * layout::entry_size);
+	}
+
+	//the CRC behind the entries, it is not aligned
+	uint32_t crc(size_t entries) const{
+		const uint8_t *crc_ptr = this->buffer + layout::crc_span(entries);
+		return (uint32_t)crc_ptr[0] | ((uint32_t)crc_ptr[1] << 8) | ((uint32_t)crc_ptr[2] << 16) | ((uint32_t)crc_ptr[3] << 24);
+	}
+
+private:
+	const uint8_t *buffer;
+	int length;
+};
+
+//sending side, fills in the CRC of a frame built in place
+template<typename FRAME, typename CRC_FUNCTION>
+void protocol_seal(FRAME &frame, CRC_FUNCTION crc_function){
+	frame.CRC = crc_function(&frame, protocol_frame<FRAME>::crc_span);
+}
+
+//variable size frame in buffer with entries entries, returns the datagram length
+template<typename HEADER, typename CRC_FUNCTION>
+size_t protocol_seal_table(uint8_t *buffer, size_t entries, CRC_FUNCTION crc_function){
+	size_t crc_span = protocol_table_frame<HEADER>::crc_span(entries);
+	uint32_t crc = crc_function(buffer, crc_span);
+	buffer[crc_span] = (uint8_t)crc;
+	buffer[crc_span + 1] = (uint8_t)(crc >> 8);
+	buffer[crc_span + 2] = (uint8_t)(crc >> 16);
+	buffer[crc_span + 3] = (uint8_t)(crc >> 24);
+	return crc_span + sizeof(uint32_t);
+}
+
+//DAC value of a normalized value on an analog out map, the three point interpolation of multiMap() in the firmware
+inline uint8_t protocol_dac_value(uint8_t normalized, int min_out, int cnt_out, int max_out){
+	if (normalized <= TRANSMITTER_NORMALIZED_MIN_OUT) return min_out;
+	if (normalized >= TRANSMITTER_NORMALIZED_MAX_OUT) return max_out;
+	if (normalized == TRANSMITTER_NORMALIZED_CNT_OUT) return cnt_out;
+	if (normalized < TRANSMITTER_NORMALIZED_CNT_OUT){
+		return (normalized - TRANSMITTER_NORMALIZED_MIN_OUT) * (cnt_out - min_out) / (TRANSMITTER_NORMALIZED_CNT_OUT - TRANSMITTER_NORMALIZED_MIN_OUT) + min_out;
+	}
+	return (normalized - TRANSMITTER_NORMALIZED_CNT_OUT) * (max_out - cnt_out) / (TRANSMITTER_NORMALIZED_MAX_OUT - TRANSMITTER_NORMALIZED_CNT_OUT) + cnt_out;
+}
+
+#endif
@@ -0,0 +1,52 @@
+// triple_buffer.h
+
+#ifndef _TRIPLE_BUFFER_h
+#define _TRIPLE_BUFFER_h
+
+#include <stdint.h>
+#include <atomic>
+
+//hands the newest value of a struct from one task to another, without a mutex and without disabling interrupts
+//one writer and one reader, neither of them ever waits: the writer fills its own slot and swaps it
+//with the shared middle slot, the reader swaps the middle slot with its own slot if it holds something new
+//the reader always gets a complete value, the newest one written before the swap
+template <typename T>
+class triple_buffer{
+public:
+	triple_buffer() : middle(1) {
+		this->slots[0] = T();
+		this->slots[1] = T();
+		this->slots[2] = T();
+		this->back = 0;
+		this->front = 2;
+	}
+
+	//writer task only
+	void write(const T &value){
+		this->slots[this->back] = value;
+		//publish, the slot of the writer is now the one the reader passed back (or the unread one)
+		this->back = this->middle.exchange(this->back | TRIPLE_BUFFER_FRESH, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX;
+	}
+
+	//reader task only, value is the newest written (or the initial T()) - returns true if it was not read before
+	bool read(T &value){
+		bool fresh = (this->middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_FRESH) != 0;
+		if (fresh){
+			this->front = this->middle.exchange(this->front, std::memory_order_acq_rel) & TRIPLE_BUFFER_INDEX;
+		}
+		value = this->slots[this->front];
+		return fresh;
+	}
+
+private:
+	static const uint8_t TRIPLE_BUFFER_INDEX = 0x03;
+	static const uint8_t TRIPLE_BUFFER_FRESH = 0x04;
+
+	T slots[3];
+	//index of the shared slot, TRIPLE_BUFFER_FRESH set by the writer until the reader takes it
+	std::atomic<uint8_t> middle;
+	uint8_t back; //owned by the writer
+	uint8_t front; //owned by the reader
+};
+
+#endif
@@ -0,0 +1,85 @@
+/************************************************************************************/
+// Arduino.h
+// Content: host shim of the ESP32 Arduino core
+// just enough of Arduino and FreeRTOS to run comm.cpp and transmitter_hal.cpp on Linux
+// pins are simulated, tasks are threads, ticks are milliseconds
+/************************************************************************************/
+
+#ifndef _HOST_ARDUINO_h
+#define _HOST_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH	1
+#define LOW		0
+
+#define INPUT			0x01
+#define OUTPUT			0x02
+#define INPUT_PULLUP	0x05
+
+#ifndef LED_BUILTIN
+#define LED_BUILTIN		2
+#endif
+
+//ESP32 has 40 GPIOs
+#define HOST_PIN_COUNT	40
+
+//time since start, wraps like on the ESP32 (32 bit)
+uint32_t millis(void);
+uint32_t micros(void);
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+//pins, analogRead returns what host_analog_input set (12 bit by default)
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+void analogReadResolution(uint8_t bits);
+void dacWrite(uint8_t pin, uint8_t value);
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+
+class HardwareSerial{
+public:
+	void begin(unsigned long baud);
+	size_t print(const char *text);
+	size_t println(const char *text);
+	size_t printf(const char *format, ...);
+};
+
+extern HardwareSerial Serial;
+
+
+//FreeRTOS, one thread per task
+typedef void(*TaskFunction_t)(void *);
+typedef void *TaskHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdPASS					1
+#define portTICK_PERIOD_MS		1
+#define configTICK_RATE_HZ		1000
+#define tskNO_AFFINITY			0x7FFFFFFF
+
+BaseType_t xTaskCreate(TaskFunction_t task_function, const char *name, uint32_t stack_depth, void *param, UBaseType_t priority, TaskHandle_t *handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_function, const char *name, uint32_t stack_depth, void *param, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id);
+void vTaskDelay(TickType_t ticks);
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t time_increment);
+void vTaskDelete(TaskHandle_t handle);
+TickType_t xTaskGetTickCount(void);
+
+
+//host side of the simulated pins, for the host main and benchmarks
+void host_analog_input(uint8_t pin, uint16_t value);
+void host_digital_input(uint8_t pin, uint8_t value);
+uint8_t host_dac_output(uint8_t pin);
+uint8_t host_digital_output(uint8_t pin);
+
+#endif
@@ -0,0 +1,28 @@
+/************************************************************************************/
+// CRC32.h
+// Content: host shim of the CRC32 Arduino library (bakercp)
+// same polynomial and conventions as the library and the server (Crc32.cpp)
+/************************************************************************************/
+
+#ifndef _HOST_CRC32_h
+#define _HOST_CRC32_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+class CRC32{
+public:
+	CRC32();
+
+	void reset(void);
+	void update(uint8_t data);
+	void update(const void *data, size_t size);
+	uint32_t finalize(void) const;
+
+	static uint32_t calculate(const void *data, size_t size);
+
+private:
+	uint32_t state;
+};
+
+#endif
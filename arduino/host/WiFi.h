@@ -0,0 +1,50 @@
+/************************************************************************************/
+// WiFi.h
+// Content: host shim of the ESP32 WiFi library
+// there is no station to join, begin() reports connected right away
+// the firmware talks to loopback, localIP() is 127.0.0.1
+/************************************************************************************/
+
+#ifndef _HOST_WIFI_h
+#define _HOST_WIFI_h
+
+#include "Arduino.h"
+
+class IPAddress{
+public:
+	IPAddress();
+	IPAddress(uint8_t first_octet, uint8_t second_octet, uint8_t third_octet, uint8_t fourth_octet);
+
+	uint8_t operator[](int index) const { return this->octets[index]; }
+	//network byte order, as in sockaddr_in
+	uint32_t to_network(void) const;
+
+private:
+	uint8_t octets[4];
+};
+
+typedef enum{
+	SYSTEM_EVENT_STA_CONNECTED,
+	SYSTEM_EVENT_STA_DISCONNECTED
+} system_event_id_t;
+
+typedef system_event_id_t WiFiEvent_t;
+typedef void(*WiFiEventCb)(system_event_id_t event);
+
+class WiFiClass{
+public:
+	WiFiClass();
+
+	void onEvent(WiFiEventCb callback);
+	bool config(IPAddress local_ip, IPAddress gateway, IPAddress subnet);
+	int begin(const char *ssid, const char *passphrase);
+	bool disconnect(bool wifioff = false);
+	IPAddress localIP(void);
+
+private:
+	WiFiEventCb event_callback;
+};
+
+extern WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,51 @@
+/************************************************************************************/
+// WiFiUdp.h
+// Content: host shim of the ESP32 WiFiUDP class on real (loopback) sockets
+// parsePacket() fetches the next datagram without blocking, read() consumes it,
+// beginPacket()/write()/endPacket() collect one datagram and send it
+/************************************************************************************/
+
+#ifndef _HOST_WIFIUDP_h
+#define _HOST_WIFIUDP_h
+
+#include "WiFi.h"
+
+#define HOST_UDP_BUFFER_SIZE	1500
+
+class WiFiUDP{
+public:
+	WiFiUDP();
+	~WiFiUDP();
+
+	uint8_t begin(uint16_t port);
+	uint8_t beginMulticast(IPAddress multicast_ip, uint16_t port);
+	void stop(void);
+
+	int beginPacket(const char *host, uint16_t port);
+	int beginPacket(IPAddress ip, uint16_t port);
+	size_t write(uint8_t data);
+	size_t write(const uint8_t *buffer, size_t size);
+	int endPacket(void);
+
+	int parsePacket(void);
+	int available(void);
+	int read(void);
+	int read(unsigned char *buffer, size_t len);
+	int read(char *buffer, size_t len);
+	size_t readBytes(char *buffer, size_t length);
+	void flush(void);
+
+private:
+	int begin_socket(uint16_t port);
+
+	int udp_socket;
+	uint8_t rx_buffer[HOST_UDP_BUFFER_SIZE];
+	int rx_length;
+	int rx_position;
+	uint8_t tx_buffer[HOST_UDP_BUFFER_SIZE];
+	size_t tx_length;
+	uint32_t tx_address; //network byte order
+	uint16_t tx_port;
+};
+
+#endif
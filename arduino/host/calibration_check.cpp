@@ -0,0 +1,117 @@
+/************************************************************************************/
+// calibration_check.cpp
+// Content: checks the calibration lookup tables (calibration.h) bit for bit against multiMap()
+// replays random calibrations the way the HAL grows them: fixed center, min falls, max rises
+// every step goes through the incremental rebuild, every ADC and override value is compared
+// the override tables of channel_table have to give what the server predicts (protocol_dac_value)
+// exits with 1 on the first mismatch
+/************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Arduino.h"
+#include "defines.h"
+#include "calibration.h"
+#include "channels.h"
+
+#define CHECK_CALIBRATIONS	200
+#define CHECK_STEPS			50
+
+static uint16_t map_normalized[MAP_SIZE] = { NORMALIZED_MIN_OUT, NORMALIZED_CNT_OUT, NORMALIZED_MAX_OUT };
+
+static bool check_in(const s_calibration_lut &lut, uint16_t *map_in){
+	for (int adc = 0; adc < CALIBRATION_ADC_SIZE; adc++){
+		uint8_t expected = multiMap(adc, map_in, map_normalized, MAP_SIZE);
+		if (calibration_normalize(lut, adc) != expected){
+			printf("adc %d (map %d/%d/%d): table %d, multiMap %d\r\n", adc, map_in[MAP_MIN_INDEX], map_in[MAP_CENTER_INDEX], map_in[MAP_MAX_INDEX], calibration_normalize(lut, adc), expected);
+			return false;
+		}
+	}
+	return true;
+}
+
+//the HAL before the tables: override values went through map() into an uint8_t, then multiMap()
+static bool check_out(const s_calibration_lut &lut, uint16_t *map_out, long override_min, long override_max){
+	for (int i = 0; i < CALIBRATION_NORMALIZED_SIZE; i++){
+		uint8_t expected = multiMap(i, map_normalized, map_out, MAP_SIZE);
+		uint8_t normalized_override = map(i, 0, 255, override_min, override_max);
+		uint8_t expected_override = multiMap(normalized_override, map_normalized, map_out, MAP_SIZE);
+		if (lut.normalized_to_out[i] != expected || lut.override_to_out[i] != expected_override){
+			printf("normalized %d: table %d/%d, multiMap %d/%d\r\n", i, lut.normalized_to_out[i], lut.override_to_out[i], expected, expected_override);
+			return false;
+		}
+	}
+	return true;
+}
+
+//the udpserver matches overrides to their echo by the DAC value protocol_dac_value() predicts
+static bool check_prediction(int channel, int min_out, int cnt_out, int max_out){
+	static s_calibration_lut lut;
+	uint16_t map_out[MAP_SIZE];
+	memcpy(map_out, channel_table[channel].map_out, sizeof(map_out));
+	calibration_build_out(lut, map_out, channel_table[channel].override_min, channel_table[channel].override_max);
+	for (int i = 0; i < CALIBRATION_NORMALIZED_SIZE; i++){
+		uint8_t predicted = protocol_dac_value(i, min_out, cnt_out, max_out);
+		if (lut.override_to_out[i] != predicted){
+			printf("channel %d override %d: table %d, server predicts %d\r\n", channel, i, lut.override_to_out[i], predicted);
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]){
+	static s_calibration_lut lut;
+	uint16_t map_throttle_out[MAP_SIZE] = { THROTTLE_MIN_OUT, THROTTLE_CNT_OUT, THROTTLE_MAX_OUT };
+	uint16_t map_steer_out[MAP_SIZE] = { STEER_MIN_OUT, STEER_CNT_OUT, STEER_MAX_OUT };
+
+	calibration_build_out(lut, map_throttle_out, THROTTLE_MIN_OUT, THROTTLE_MAX_OUT);
+	if (!check_out(lut, map_throttle_out, THROTTLE_MIN_OUT, THROTTLE_MAX_OUT)){
+		return 1;
+	}
+	calibration_build_out(lut, map_steer_out, NORMALIZED_MIN_OUT, NORMALIZED_MAX_OUT);
+	if (!check_out(lut, map_steer_out, NORMALIZED_MIN_OUT, NORMALIZED_MAX_OUT)){
+		return 1;
+	}
+
+	if (!check_prediction(TRANSMITTER_CHANNEL_THROTTLE, TRANSMITTER_THROTTLE_MIN_OUT, TRANSMITTER_THROTTLE_CNT_OUT, TRANSMITTER_THROTTLE_MAX_OUT)
+		|| !check_prediction(TRANSMITTER_CHANNEL_STEER, TRANSMITTER_STEER_MIN_OUT, TRANSMITTER_STEER_CNT_OUT, TRANSMITTER_STEER_MAX_OUT)){
+		return 1;
+	}
+
+	srand(1);
+	for (int calibration = 0; calibration < CHECK_CALIBRATIONS; calibration++){
+		uint16_t map_in[MAP_SIZE];
+		map_in[MAP_CENTER_INDEX] = MINIMAL_ACCEPTED_CALIBRATION_RANGE + 1 + rand() % (CALIBRATION_ADC_SIZE - 2 * (MINIMAL_ACCEPTED_CALIBRATION_RANGE + 1));
+		map_in[MAP_MIN_INDEX] = map_in[MAP_CENTER_INDEX] - MINIMAL_ACCEPTED_CALIBRATION_RANGE - 1;
+		map_in[MAP_MAX_INDEX] = map_in[MAP_CENTER_INDEX] + MINIMAL_ACCEPTED_CALIBRATION_RANGE + 1;
+		//a new HAL start, the first build is a full one
+		lut.valid = false;
+
+		for (int step = 0; step < CHECK_STEPS; step++){
+			calibration_update_in(lut, map_in);
+			if (!check_in(lut, map_in)){
+				return 1;
+			}
+			//the range grows on one or both ends, or stays
+			switch (rand() % 4){
+			case 0:
+				map_in[MAP_MIN_INDEX] -= rand() % (map_in[MAP_MIN_INDEX] / 4 + 1);
+				break;
+			case 1:
+				map_in[MAP_MAX_INDEX] += rand() % ((CALIBRATION_ADC_SIZE - 1 - map_in[MAP_MAX_INDEX]) / 4 + 1);
+				break;
+			case 2:
+				map_in[MAP_MIN_INDEX] -= rand() % (map_in[MAP_MIN_INDEX] / 4 + 1);
+				map_in[MAP_MAX_INDEX] += rand() % ((CALIBRATION_ADC_SIZE - 1 - map_in[MAP_MAX_INDEX]) / 4 + 1);
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	printf("calibration tables match multiMap (%d calibrations, %d steps each)\r\n", CHECK_CALIBRATIONS, CHECK_STEPS);
+	return 0;
+}
@@ -0,0 +1,430 @@
+/************************************************************************************/
+// crc32_bench.cpp
+// Content: every CRC32 kernel of the udpserver (Crc32.h) across packet and bulk sizes
+// correctness: each kernel against crc32_bitwise, unaligned and chained, and crc32_combine,
+// exits with 1 on a mismatch
+// parallel: crc32_parallel on a pool of one thread per core (the calling thread takes a part too)
+// batches: crc32_verify_frames against checking frame by frame (fixed, fast), warm, ns per frame,
+// the frames in receive slots of the udpserver with about a third of them corrupted
+// warm: the same few buffers over and over, tables and data stay in L1/L2
+// cold: L1/L2 flushed by a walk over an eviction buffer before every single call,
+// what a frame sees between the socket and the rest of the server (L3 may still hold it)
+// results go to stdout and as CSV to the file given as argument (default crc32_bench.csv)
+/************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <thread>
+
+#include "Crc32.h"
+#include "threadpool.h"
+
+//hot path frames (2, 8, 12, 20 bytes) up to recordings
+static const size_t bench_sizes[] = { 2, 8, 12, 20, 64, 256, 1024, 16 * 1024, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024 };
+
+//a warm measurement is the fastest of BENCH_WARM_RUNS runs of at least BENCH_WARM_NS each,
+//the best run is the one least disturbed by the rest of the machine
+#define BENCH_WARM_NS			4000000
+#define BENCH_WARM_RUNS			5
+//independent buffers of a warm run, small ones rotate so consecutive calls do not chain
+#define BENCH_WARM_BUFFERS		16
+//timed single calls of a cold run, the median is reported
+//a cold run stops after BENCH_WARM_RUNS * BENCH_WARM_NS as well, once it has BENCH_COLD_MIN_CALLS
+#define BENCH_COLD_CALLS		64
+#define BENCH_COLD_MIN_CALLS	8
+//4x the L2 of current desktop and server cores
+#define BENCH_EVICT_BYTES		(8 * 1024 * 1024)
+//random buffers per size of the cross-check, fewer above BENCH_CHECK_LARGE bytes (crc32_bitwise is slow)
+#define BENCH_CHECK_ROUNDS		64
+#define BENCH_CHECK_LARGE_ROUNDS	4
+#define BENCH_CHECK_LARGE		(64 * 1024)
+//frames of a batch lie in receive slots of this size (RECV_BUFFER_SIZE of the udpserver)
+#define BENCH_BATCH_STRIDE		1500
+
+typedef uint32_t(*t_crc32_kernel)(const void* data, size_t length, uint32_t previousCrc32);
+
+struct s_bench_kernel{
+	const char *name;
+	t_crc32_kernel kernel;
+	//false if the kernel does not handle this length
+	bool (*handles)(size_t length);
+};
+
+static bool any_length(size_t){
+	return true;
+}
+
+//the lengths with a crc32_fixed<N>() instance
+static bool fixed_length(size_t length){
+	return length == 2 || length == 8 || length == 12 || length == 20 || length == 64;
+}
+
+static uint32_t bench_crc32_fixed(const void* data, size_t length, uint32_t previousCrc32){
+	switch (length){
+	case 2:
+		return crc32_fixed<2>(data, previousCrc32);
+	case 8:
+		return crc32_fixed<8>(data, previousCrc32);
+	case 12:
+		return crc32_fixed<12>(data, previousCrc32);
+	case 20:
+		return crc32_fixed<20>(data, previousCrc32);
+	default:
+		return crc32_fixed<64>(data, previousCrc32);
+	}
+}
+
+static ThreadPool *bench_pool = NULL;
+
+static uint32_t bench_crc32_parallel(const void* data, size_t length, uint32_t previousCrc32){
+	return crc32_parallel(data, length, *bench_pool, previousCrc32);
+}
+
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
+static uint32_t bench_crc32_16bytes_prefetch(const void* data, size_t length, uint32_t previousCrc32){
+	return crc32_16bytes_prefetch(data, length, previousCrc32);
+}
+#endif
+
+static const s_bench_kernel bench_kernels[] = {
+	{ "bitwise", crc32_bitwise, any_length },
+	{ "halfbyte", crc32_halfbyte, any_length },
+#ifdef CRC32_USE_LOOKUP_TABLE_BYTE
+	{ "1byte", crc32_1byte, any_length },
+#endif
+	{ "1byte_tableless", crc32_1byte_tableless, any_length },
+	{ "1byte_tableless2", crc32_1byte_tableless2, any_length },
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_4
+	{ "4bytes", crc32_4bytes, any_length },
+#endif
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_8
+	{ "8bytes", crc32_8bytes, any_length },
+	{ "4x8bytes", crc32_4x8bytes, any_length },
+#endif
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
+	{ "16bytes", crc32_16bytes, any_length },
+	{ "16bytes_prefetch", bench_crc32_16bytes_prefetch, any_length },
+#endif
+#ifdef CRC32_USE_PCLMULQDQ
+	{ "pclmul", crc32_pclmul, any_length },
+#endif
+	{ "fixed", bench_crc32_fixed, fixed_length },
+	{ "parallel", bench_crc32_parallel, any_length },
+	{ "fast", crc32_fast, any_length },
+};
+
+//summed, so the compiler keeps the calls
+//state frame sizes without CRC, and the longest frame the SIMD lanes take
+static const size_t batch_lengths[] = { 2, 8, 12, 20, 60 };
+static const size_t batch_counts[] = { 8, 16, 32, 64 };
+
+typedef uint64_t(*t_verify_batch)(const void* frames, size_t stride, size_t count, size_t length);
+
+//the little endian CRC behind a frame, as protocol_table_view reads it
+static uint32_t stored_crc(const uint8_t *frame, size_t length){
+	return (uint32_t)frame[length] | ((uint32_t)frame[length + 1] << 8) | ((uint32_t)frame[length + 2] << 16) | ((uint32_t)frame[length + 3] << 24);
+}
+
+static uint64_t verify_each_fast(const void* frames, size_t stride, size_t count, size_t length){
+	uint64_t valid = 0;
+	for (size_t i = 0; i < count; i++){
+		const uint8_t *frame = (const uint8_t *)frames + i * stride;
+		if (crc32_fast(frame, length) == stored_crc(frame, length)){
+			valid |= (uint64_t)1 << i;
+		}
+	}
+	return valid;
+}
+
+//crc32_fixed where there is one, as frame_crc of the udpserver
+static uint32_t frame_crc(const void* data, size_t length){
+	return fixed_length(length) ? bench_crc32_fixed(data, length, 0) : crc32_fast(data, length);
+}
+
+static uint64_t verify_each_fixed(const void* frames, size_t stride, size_t count, size_t length){
+	uint64_t valid = 0;
+	for (size_t i = 0; i < count; i++){
+		const uint8_t *frame = (const uint8_t *)frames + i * stride;
+		if (frame_crc(frame, length) == stored_crc(frame, length)){
+			valid |= (uint64_t)1 << i;
+		}
+	}
+	return valid;
+}
+
+//the lanes and the frames they leave over checked as the udpserver does
+static uint64_t verify_frames(const void* frames, size_t stride, size_t count, size_t length){
+	return crc32_verify_frames(frames, stride, count, length, frame_crc);
+}
+
+struct s_bench_batch{
+	const char *name;
+	t_verify_batch verify;
+};
+
+static const s_bench_batch bench_batches[] = {
+	{ "each_fast", verify_each_fast },
+	{ "each_fixed", verify_each_fixed },
+	{ "verify_frames", verify_frames },
+};
+
+static volatile uint32_t sink = 0;
+
+static void fill_random(uint8_t *buffer, size_t length){
+	for (size_t i = 0; i < length; i++){
+		buffer[i] = (uint8_t)rand();
+	}
+}
+
+//every kernel against crc32_bitwise: all offsets of an 8 byte alignment, random previousCrc32,
+//and the buffer split in two chained calls
+static bool check(const s_bench_kernel &bench, size_t length, std::vector<uint8_t> &buffer){
+	int rounds = length > BENCH_CHECK_LARGE ? BENCH_CHECK_LARGE_ROUNDS : BENCH_CHECK_ROUNDS;
+	for (int round = 0; round < rounds; round++){
+		size_t offset = round % 8;
+		uint8_t *data = &buffer[offset];
+		uint32_t previous = round == 0 ? 0 : ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		fill_random(data, length);
+		uint32_t expected = crc32_bitwise(data, length, previous);
+		uint32_t result = bench.kernel(data, length, previous);
+		if (result != expected){
+			printf("%s: %zu bytes at offset %zu: %08X, bitwise %08X\r\n", bench.name, length, offset, result, expected);
+			return false;
+		}
+		//chaining needs any length, the fixed kernels only get their own
+		if (bench.handles == any_length && length > 1){
+			size_t split = (size_t)rand() % length;
+			result = bench.kernel(data + split, length - split, bench.kernel(data, split, previous));
+			if (result != expected){
+				printf("%s: %zu bytes chained at %zu: %08X, bitwise %08X\r\n", bench.name, length, split, result, expected);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+//crc32_combine of a random split against the CRC of the whole buffer
+static bool check_combine(size_t length, std::vector<uint8_t> &buffer){
+	for (int round = 0; round < BENCH_CHECK_ROUNDS; round++){
+		size_t split = round == 0 ? length : (size_t)rand() % (length + 1);
+		uint32_t previous = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+		fill_random(&buffer[0], length);
+		uint32_t expected = crc32_fast(&buffer[0], length, previous);
+		uint32_t result = crc32_combine(crc32_fast(&buffer[0], split, previous), crc32_fast(&buffer[split], length - split), length - split);
+		if (result != expected){
+			printf("crc32_combine: %zu bytes split at %zu: %08X, whole %08X\r\n", length, split, result, expected);
+			return false;
+		}
+	}
+	return true;
+}
+
+//count frames sealed with their CRC, about a third of them with a flipped bit or a wrong CRC
+static void fill_batch(uint8_t *frames, size_t count, size_t length){
+	for (size_t i = 0; i < count; i++){
+		uint8_t *frame = frames + i * BENCH_BATCH_STRIDE;
+		fill_random(frame, BENCH_BATCH_STRIDE);
+		uint32_t crc = crc32_bitwise(frame, length);
+		memcpy(frame + length, &crc, sizeof(crc));
+		if (rand() % 3 == 0){
+			frame[(size_t)rand() % (length + sizeof(crc))] ^= (uint8_t)(1 << (rand() % 8));
+		}
+	}
+}
+
+//crc32_verify_frames against crc32_bitwise frame by frame, every count up to CRC32_VERIFY_MAX_FRAMES
+static bool check_verify_frames(size_t length, std::vector<uint8_t> &frames){
+	for (size_t count = 0; count <= CRC32_VERIFY_MAX_FRAMES; count++){
+		fill_batch(&frames[0], count, length);
+		uint64_t expected = 0;
+		for (size_t i = 0; i < count; i++){
+			const uint8_t *frame = &frames[i * BENCH_BATCH_STRIDE];
+			if (crc32_bitwise(frame, length) == stored_crc(frame, length)){
+				expected |= (uint64_t)1 << i;
+			}
+		}
+		uint64_t result = crc32_verify_frames(&frames[0], BENCH_BATCH_STRIDE, count, length);
+		uint64_t result_fixed = crc32_verify_frames(&frames[0], BENCH_BATCH_STRIDE, count, length, frame_crc);
+		if (result != expected || result_fixed != expected){
+			printf("crc32_verify_frames: %zu frames of %zu bytes: %016llX (fixed rest %016llX), bitwise %016llX\r\n", count, length, (unsigned long long)result, (unsigned long long)result_fixed, (unsigned long long)expected);
+			return false;
+		}
+	}
+	return true;
+}
+
+static double ns_since(std::chrono::steady_clock::time_point start){
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static double warm_ns(const s_bench_kernel &bench, size_t length, const std::vector<uint8_t> &buffers, size_t stride){
+	size_t buffer_count = buffers.size() / stride;
+	uint32_t sum = 0;
+	//one untimed call per buffer loads tables and data
+	for (size_t i = 0; i < buffer_count; i++){
+		sum += bench.kernel(&buffers[i * stride], length, 0);
+	}
+	double best = 0;
+	for (int run = 0; run < BENCH_WARM_RUNS; run++){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t calls = 0;
+		double elapsed = 0;
+		do {
+			//a batch between clock reads, so small kernels are not dominated by the clock
+			for (int batch = 0; batch < 64; batch++){
+				sum += bench.kernel(&buffers[(calls % buffer_count) * stride], length, 0);
+				calls++;
+			}
+			elapsed = ns_since(start);
+		} while (elapsed < BENCH_WARM_NS);
+		if (run == 0 || elapsed / calls < best){
+			best = elapsed / calls;
+		}
+	}
+	sink += sum;
+	return best;
+}
+
+//per frame, same best of BENCH_WARM_RUNS as warm_ns
+static double batch_ns(const s_bench_batch &bench, size_t length, size_t count, const std::vector<uint8_t> &frames){
+	uint64_t sum = bench.verify(&frames[0], BENCH_BATCH_STRIDE, count, length);
+	double best = 0;
+	for (int run = 0; run < BENCH_WARM_RUNS; run++){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		size_t calls = 0;
+		double elapsed = 0;
+		do {
+			for (int batch = 0; batch < 16; batch++){
+				sum += bench.verify(&frames[0], BENCH_BATCH_STRIDE, count, length);
+				calls++;
+			}
+			elapsed = ns_since(start);
+		} while (elapsed < BENCH_WARM_NS);
+		if (run == 0 || elapsed / (calls * count) < best){
+			best = elapsed / (calls * count);
+		}
+	}
+	sink += (uint32_t)sum;
+	return best;
+}
+
+static double clock_overhead_ns(void){
+	std::vector<double> samples(BENCH_COLD_CALLS);
+	for (int i = 0; i < BENCH_COLD_CALLS; i++){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		samples[i] = ns_since(start);
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[BENCH_COLD_CALLS / 2];
+}
+
+static void evict(std::vector<uint8_t> &evict_buffer){
+	//a store per cache line pushes out everything else, written so it cannot be skipped
+	for (size_t i = 0; i < evict_buffer.size(); i += 64){
+		evict_buffer[i]++;
+	}
+	sink += evict_buffer[(size_t)rand() % evict_buffer.size()];
+}
+
+static double cold_ns(const s_bench_kernel &bench, size_t length, const std::vector<uint8_t> &buffer, std::vector<uint8_t> &evict_buffer, double overhead){
+	std::vector<double> samples;
+	uint32_t sum = 0;
+	double elapsed = 0;
+	while (samples.size() < BENCH_COLD_CALLS && (samples.size() < BENCH_COLD_MIN_CALLS || elapsed < BENCH_WARM_RUNS * BENCH_WARM_NS)){
+		evict(evict_buffer);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		sum += bench.kernel(&buffer[0], length, 0);
+		double ns = ns_since(start);
+		samples.push_back(std::max(ns - overhead, 0.0));
+		elapsed += ns;
+	}
+	sink += sum;
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+int main(int argc, char *argv[]){
+	const char *csv_name = argc > 1 ? argv[1] : "crc32_bench.csv";
+	const size_t max_size = bench_sizes[sizeof(bench_sizes) / sizeof(bench_sizes[0]) - 1];
+	std::vector<uint8_t> check_buffer(max_size + 8);
+	std::vector<uint8_t> evict_buffer(BENCH_EVICT_BYTES);
+	ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+	bench_pool = &pool;
+
+	srand(1);
+	for (const s_bench_kernel &bench : bench_kernels){
+		for (size_t length : bench_sizes){
+			if (bench.handles(length) && !check(bench, length, check_buffer)){
+				return 1;
+			}
+		}
+	}
+	for (size_t length : bench_sizes){
+		if (!check_combine(length, check_buffer)){
+			return 1;
+		}
+	}
+	std::vector<uint8_t> batch_frames(CRC32_VERIFY_MAX_FRAMES * BENCH_BATCH_STRIDE);
+	for (size_t length : batch_lengths){
+		if (!check_verify_frames(length, batch_frames)){
+			return 1;
+		}
+	}
+	printf("all kernels match crc32_bitwise, crc32_combine matches the whole buffer, crc32_verify_frames every frame\r\n");
+#ifdef CRC32_USE_PCLMULQDQ
+	if (!crc32_pclmul_supported()){
+		printf("no PCLMULQDQ, pclmul falls back to fast\r\n");
+	}
+#endif
+
+	FILE *csv = fopen(csv_name, "w");
+	if (csv == NULL){
+		printf("cannot write %s\r\n", csv_name);
+		return 1;
+	}
+	fprintf(csv, "kernel,bytes,mode,ns_per_call,gb_per_s\n");
+
+	double overhead = clock_overhead_ns();
+	printf("%-18s %10s %12s %10s %12s %10s\r\n", "kernel", "bytes", "warm ns", "warm GB/s", "cold ns", "cold GB/s");
+	for (size_t length : bench_sizes){
+		//small buffers rotate within L1, large ones are a single buffer
+		size_t stride = (length + 63) & ~(size_t)63;
+		size_t buffer_count = stride * BENCH_WARM_BUFFERS <= 16 * 1024 ? BENCH_WARM_BUFFERS : 1;
+		std::vector<uint8_t> buffers(stride * buffer_count);
+		fill_random(&buffers[0], buffers.size());
+
+		for (const s_bench_kernel &bench : bench_kernels){
+			if (!bench.handles(length)){
+				continue;
+			}
+			double warm = warm_ns(bench, length, buffers, stride);
+			double cold = cold_ns(bench, length, buffers, evict_buffer, overhead);
+			//bytes per ns is GB/s
+			double warm_rate = length / warm;
+			double cold_rate = cold > 0 ? length / cold : 0;
+			printf("%-18s %10zu %12.2f %10.3f %12.2f %10.3f\r\n", bench.name, length, warm, warm_rate, cold, cold_rate);
+			fprintf(csv, "%s,%zu,warm,%.3f,%.4f\n", bench.name, length, warm, warm_rate);
+			fprintf(csv, "%s,%zu,cold,%.3f,%.4f\n", bench.name, length, cold, cold_rate);
+		}
+	}
+
+	printf("\r\n%-18s %10s %10s %12s\r\n", "batch", "bytes", "frames", "ns/frame");
+	for (size_t length : batch_lengths){
+		for (size_t count : batch_counts){
+			fill_batch(&batch_frames[0], count, length);
+			for (const s_bench_batch &bench : bench_batches){
+				double ns = batch_ns(bench, length, count, batch_frames);
+				printf("%-18s %10zu %10zu %12.2f\r\n", bench.name, length, count, ns);
+				fprintf(csv, "%s,%zu,batch%zu,%.3f,%.4f\n", bench.name, length, count, ns, length / ns);
+			}
+		}
+	}
+	fclose(csv);
+	printf("results written to %s (clock overhead %.1f ns subtracted from the cold calls)\r\n", csv_name, overhead);
+	return 0;
+}
@@ -0,0 +1,11 @@
+/************************************************************************************/
+// esp_task_wdt.h
+// Content: host shim of the ESP-IDF task watchdog, there is none on the host
+/************************************************************************************/
+
+#ifndef _HOST_ESP_TASK_WDT_h
+#define _HOST_ESP_TASK_WDT_h
+
+inline void esp_task_wdt_feed(void){}
+
+#endif
@@ -0,0 +1,169 @@
+/************************************************************************************/
+// exchange_stress.cpp
+// Content: stress of triple_buffer (triple_buffer.h) and sample_ring (sample_ring.h), the HAL <-> comm state exchange
+// a writer thread publishes values as fast as it can, a reader thread checks every snapshot:
+// all fields from the same write (no tearing), never older than the previous one
+// the samples of the ring are read the way the batch frame does and over the whole ring,
+// every sample kept has to be the one of its index, complete
+// exits with 1 on the first inconsistent snapshot
+// build with CXXFLAGS="-O1 -g -fsanitize=thread" to let ThreadSanitizer check the memory ordering
+/************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <atomic>
+
+#include "triple_buffer.h"
+#include "sample_ring.h"
+#include "comm.h"
+#include "transmitter_hal.h"
+
+#define STRESS_WRITES		10000000
+#define STRESS_WORDS		16
+
+//large enough that a copy is many stores, every word carries the write number
+struct s_stress_value{
+	uint32_t words[STRESS_WORDS];
+};
+
+static triple_buffer<s_stress_value> stress_buffer;
+static triple_buffer<s_transmitter_override> override_buffer;
+static sample_ring<s_transmitter_sample, TRANSMITTER_SAMPLE_RING_SIZE> sample_buffer;
+static std::atomic<bool> writer_done(false);
+
+//every field of sample n carries a part of n
+static void stress_sample(uint32_t n, s_transmitter_sample &sample){
+	sample.timestamp_us = n;
+	sample.state.in_throttle = (uint8_t)n;
+	sample.state.in_steer = (uint8_t)(n >> 8);
+	sample.state.in_button = (uint16_t)n;
+	sample.state.out_throttle = (uint8_t)(n >> 16);
+	sample.state.out_steer = (uint8_t)(n >> 24);
+	sample.state.battery_voltage_mv = (uint16_t)(n >> 16);
+}
+
+//n samples from index first on, the oldest of them may be gone - returns false on a torn or wrong sample
+static bool check_samples(uint32_t first, uint32_t n, uint32_t &kept, uint32_t &dropped){
+	static s_transmitter_sample samples[TRANSMITTER_SAMPLE_RING_SIZE];
+	uint32_t overwritten = sample_buffer.read(first, n, samples);
+	for (uint32_t i = overwritten; i < n; i++){
+		s_transmitter_sample expected;
+		//sample index k is write k + 1
+		stress_sample(first + i + 1, expected);
+		if (memcmp(&samples[i], &expected, sizeof(expected)) != 0){
+			printf("sample %u: torn or stale, timestamp %u\r\n", first + i, samples[i].timestamp_us);
+			return false;
+		}
+	}
+	kept += n - overwritten;
+	dropped += overwritten;
+	return true;
+}
+
+static void stress_writer(void){
+	s_stress_value value;
+	s_transmitter_override output_override;
+	s_transmitter_sample sample;
+	memset(&output_override, 0, sizeof(output_override));
+	for (uint32_t n = 1; n <= STRESS_WRITES; n++){
+		for (int i = 0; i < STRESS_WORDS; i++){
+			value.words[i] = n;
+		}
+		stress_buffer.write(value);
+
+		//64 bit timestamp crossing 32 bit boundaries, the former tearing case of the override
+		output_override.millis_last_update = ((uint64_t)n << 32) | n;
+		output_override.out_steer = (uint8_t)n;
+		output_override.out_throttle = (uint8_t)n;
+		output_override.CRC = n;
+		output_override.ready = true;
+		override_buffer.write(output_override);
+
+		stress_sample(n, sample);
+		sample_buffer.write(sample);
+	}
+	writer_done = true;
+}
+
+int main(int argc, char *argv[]){
+	std::thread writer(stress_writer);
+	s_stress_value value;
+	s_transmitter_override output_override;
+	uint32_t last_value = 0;
+	uint32_t last_override = 0;
+	uint32_t fresh_reads = 0;
+	uint32_t reads = 0;
+	uint32_t last_sample_count = 0;
+	uint32_t samples_kept = 0;
+	uint32_t samples_dropped = 0;
+	bool failed = false;
+
+	while (!failed){
+		bool done = writer_done;
+		if (stress_buffer.read(value)){
+			fresh_reads++;
+		}
+		reads++;
+		for (int i = 1; i < STRESS_WORDS; i++){
+			if (value.words[i] != value.words[0]){
+				printf("torn value: word 0 is %u, word %d is %u\r\n", value.words[0], i, value.words[i]);
+				failed = true;
+				break;
+			}
+		}
+		if (value.words[0] < last_value){
+			printf("value went back from %u to %u\r\n", last_value, value.words[0]);
+			failed = true;
+		}
+		last_value = value.words[0];
+
+		override_buffer.read(output_override);
+		if (output_override.ready){
+			uint32_t n = output_override.CRC;
+			if (output_override.millis_last_update != (((uint64_t)n << 32) | n) || output_override.out_steer != (uint8_t)n || output_override.out_throttle != (uint8_t)n){
+				printf("torn override of write %u\r\n", n);
+				failed = true;
+			}
+			if (n < last_override){
+				printf("override went back from %u to %u\r\n", last_override, n);
+				failed = true;
+			}
+			last_override = n;
+		}
+
+		//as the batch frame: what is new since the last round, at most TELEMETRY_BATCH_SIZE of the newest
+		//every other round the whole ring, its oldest slots are the ones being overwritten
+		uint32_t sample_count = sample_buffer.count();
+		if (sample_count < last_sample_count){
+			printf("sample count went back from %u to %u\r\n", last_sample_count, sample_count);
+			failed = true;
+		}
+		uint32_t new_samples = sample_count - last_sample_count;
+		uint32_t max_samples = (reads & 1) ? TELEMETRY_BATCH_SIZE : TRANSMITTER_SAMPLE_RING_SIZE;
+		if (new_samples > max_samples){
+			new_samples = max_samples;
+		}
+		if (!failed && !check_samples(sample_count - new_samples, new_samples, samples_kept, samples_dropped)){
+			failed = true;
+		}
+		last_sample_count = sample_count;
+
+		//one more round after the writer finished must see the last write
+		if (done){
+			if (!failed && (last_value != STRESS_WRITES || last_override != STRESS_WRITES || last_sample_count != STRESS_WRITES)){
+				printf("last write not seen: %u/%u/%u of %u\r\n", last_value, last_override, last_sample_count, STRESS_WRITES);
+				failed = true;
+			}
+			break;
+		}
+	}
+	writer.join();
+
+	if (failed){
+		return 1;
+	}
+	printf("triple_buffer consistent: %u writes, %u reads, %u of them fresh\r\n", STRESS_WRITES, reads, fresh_reads);
+	printf("sample_ring consistent: %u samples read, %u dropped as overwritten\r\n", samples_kept, samples_dropped);
+	return 0;
+}
@@ -0,0 +1,150 @@
+/************************************************************************************/
+// filter_bench.cpp
+// Content: accuracy and throughput of the input filters (filter.h) on the host
+// accuracy: each kernel against a double precision reference of the same filter
+// throughput: ns per sample against the former double precision IIR of the HAL
+// host timings only compare the kernels, the ESP32 runs double in soft-float
+/************************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include "filter.h"
+
+//12 bit ADC, stick sweep with noise and single sample spikes
+#define BENCH_SAMPLES			(1 << 20)
+#define BENCH_CENTER			2048
+#define BENCH_AMPLITUDE			1500
+#define BENCH_PERIOD			2000
+#define BENCH_NOISE				8
+#define BENCH_SPIKE_INTERVAL	97
+#define BENCH_SPIKE				900
+#define BENCH_ROUNDS			8
+
+struct s_bench_filter{
+	const char *name;
+	uint8_t type;
+	uint8_t param;
+};
+
+static const s_bench_filter bench_filters[] = {
+	{ "none", FILTER_TYPE_NONE, 0 },
+	{ "iir 1/2", FILTER_TYPE_IIR, 1 },
+	{ "iir 1/8", FILTER_TYPE_IIR, 3 },
+	{ "average 4", FILTER_TYPE_MOVING_AVERAGE, 4 },
+	{ "average 16", FILTER_TYPE_MOVING_AVERAGE, 16 },
+	{ "median 3", FILTER_TYPE_MEDIAN, 3 },
+	{ "median 5", FILTER_TYPE_MEDIAN, 5 },
+};
+
+static std::vector<uint16_t> make_input(void){
+	std::vector<uint16_t> input(BENCH_SAMPLES);
+	srand(1);
+	for (int i = 0; i < BENCH_SAMPLES; i++){
+		int value = (int)(BENCH_CENTER + BENCH_AMPLITUDE * sin(2 * M_PI * i / BENCH_PERIOD)) + rand() % (2 * BENCH_NOISE + 1) - BENCH_NOISE;
+		if (i % BENCH_SPIKE_INTERVAL == 0){
+			value += BENCH_SPIKE;
+		}
+		input[i] = (uint16_t)std::min(std::max(value, 0), 4095);
+	}
+	return input;
+}
+
+//the same filters in double precision, error of the fixed point kernels is measured against these
+static std::vector<double> reference(const std::vector<uint16_t> &input, uint8_t type, uint8_t param){
+	std::vector<double> output(input.size());
+	std::vector<double> window(param > 0 ? param : 1, input[0]);
+	double state = input[0];
+	double sum = input[0] * (double)window.size();
+	for (size_t i = 0; i < input.size(); i++){
+		switch (type){
+		case FILTER_TYPE_IIR:
+			state += (input[i] - state) / (double)(1 << param);
+			output[i] = state;
+			break;
+		case FILTER_TYPE_MOVING_AVERAGE:
+			sum += input[i] - window[i % param];
+			window[i % param] = input[i];
+			output[i] = sum / param;
+			break;
+		case FILTER_TYPE_MEDIAN:{
+			window[i % param] = input[i];
+			std::vector<double> sorted(window);
+			std::sort(sorted.begin(), sorted.end());
+			output[i] = sorted[param / 2];
+			break;
+		}
+		default:
+			output[i] = input[i];
+			break;
+		}
+	}
+	return output;
+}
+
+//the filter of the HAL before filter.h, FILTER_FRACTION 2.0
+static uint16_t legacy_update(uint16_t &state, uint16_t sample){
+	state = state + (((double)sample - (double)state) / 2.0);
+	return state;
+}
+
+static double ns_per_sample(std::chrono::steady_clock::duration elapsed){
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / ((double)BENCH_SAMPLES * BENCH_ROUNDS);
+}
+
+int main(int argc, char *argv[]){
+	std::vector<uint16_t> input = make_input();
+	//summed, so the compiler keeps the loops
+	volatile uint32_t sink = 0;
+
+	printf("%-12s %12s %12s %12s\r\n", "filter", "max error", "mean error", "ns/sample");
+
+	uint16_t legacy_state = input[0];
+	uint32_t legacy_sum = 0;
+	double legacy_max = 0;
+	double legacy_total = 0;
+	std::vector<double> legacy_reference = reference(input, FILTER_TYPE_IIR, 1);
+	for (size_t i = 0; i < input.size(); i++){
+		double error = fabs(legacy_update(legacy_state, input[i]) - legacy_reference[i]);
+		legacy_max = std::max(legacy_max, error);
+		legacy_total += error;
+	}
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int round = 0; round < BENCH_ROUNDS; round++){
+		legacy_state = input[0];
+		for (size_t i = 0; i < input.size(); i++){
+			legacy_sum += legacy_update(legacy_state, input[i]);
+		}
+	}
+	sink += legacy_sum;
+	printf("%-12s %12.3f %12.3f %12.3f\r\n", "legacy 1/2", legacy_max, legacy_total / input.size(), ns_per_sample(std::chrono::steady_clock::now() - start));
+
+	for (const s_bench_filter &bench : bench_filters){
+		s_filter filter;
+		std::vector<double> expected = reference(input, bench.type, bench.param);
+		double max_error = 0;
+		double total_error = 0;
+		filter_init(filter, bench.type, bench.param, input[0]);
+		for (size_t i = 0; i < input.size(); i++){
+			double error = fabs(filter_update(filter, input[i]) - expected[i]);
+			max_error = std::max(max_error, error);
+			total_error += error;
+		}
+
+		uint32_t sum = 0;
+		start = std::chrono::steady_clock::now();
+		for (int round = 0; round < BENCH_ROUNDS; round++){
+			filter_init(filter, bench.type, bench.param, input[0]);
+			for (size_t i = 0; i < input.size(); i++){
+				sum += filter_update(filter, input[i]);
+			}
+		}
+		sink += sum;
+		printf("%-12s %12.3f %12.3f %12.3f\r\n", bench.name, max_error, total_error / input.size(), ns_per_sample(std::chrono::steady_clock::now() - start));
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+/************************************************************************************/
+// host_main.cpp
+// Content: runs the sketch (setup() once, loop() forever) on the host
+// a simulated rc-transmitter moves the sticks, so the HAL calibrates and live data changes:
+// sticks rest at the center while the HAL takes its zero point, then sweep full range
+// every channel of channel_table is moved, neighbouring channels in opposite directions
+/************************************************************************************/
+
+#include <thread>
+#include <chrono>
+
+#include "Arduino.h"
+#include "defines.h"
+#include "channels.h"
+
+//sticks rest until the HAL has its zero point (input settling + filter)
+//with a stored calibration (host_storage_calibration.bin) the HAL is live right after settling
+#define SIMULATION_REST_MS		1000
+#define SIMULATION_CENTER		2048
+#define SIMULATION_AMPLITUDE	1500
+#define SIMULATION_PERIOD_MS	2000
+//~3.7V behind the voltage divider, 12 bit
+#define SIMULATION_BATTERY		2300
+
+void setup();
+void loop();
+
+static void simulate_transmitter(void){
+	host_analog_input(BATTERY_VOLTAGE_SENSE, SIMULATION_BATTERY);
+	while (true){
+		uint32_t now = millis();
+		double phase = 0;
+		if (now > SIMULATION_REST_MS){
+			phase = 2 * M_PI * (now - SIMULATION_REST_MS) / SIMULATION_PERIOD_MS;
+		}
+		for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+			host_analog_input(channel_table[channel].sense_pin, (uint16_t)(SIMULATION_CENTER + SIMULATION_AMPLITUDE * sin(phase + channel * M_PI)));
+		}
+		host_digital_input(BUTTON_SENSE_PIN, (now / SIMULATION_PERIOD_MS) % 2);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+int main(int argc, char *argv[]){
+	std::thread(simulate_transmitter).detach();
+	setup();
+	while (true){
+		loop();
+	}
+	return 0;
+}
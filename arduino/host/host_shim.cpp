@@ -0,0 +1,386 @@
+/************************************************************************************/
+// host_shim.cpp
+// Content: host shim of Arduino, FreeRTOS, WiFi, WiFiUDP and CRC32
+// see Arduino.h, WiFi.h, WiFiUdp.h, CRC32.h
+/************************************************************************************/
+
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <stdarg.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "Arduino.h"
+#include "WiFi.h"
+#include "WiFiUdp.h"
+#include "CRC32.h"
+
+using namespace std;
+
+static const chrono::steady_clock::time_point host_start = chrono::steady_clock::now();
+
+//simulated pins
+static atomic<uint16_t> analog_inputs[HOST_PIN_COUNT];
+static atomic<uint8_t> digital_inputs[HOST_PIN_COUNT];
+static atomic<uint8_t> digital_outputs[HOST_PIN_COUNT];
+static atomic<uint8_t> dac_outputs[HOST_PIN_COUNT];
+static uint8_t analog_resolution = 12;
+
+HardwareSerial Serial;
+WiFiClass WiFi;
+
+
+uint32_t millis(void){
+	return (uint32_t)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - host_start).count();
+}
+
+uint32_t micros(void){
+	return (uint32_t)chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - host_start).count();
+}
+
+void delay(uint32_t ms){
+	this_thread::sleep_for(chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us){
+	this_thread::sleep_for(chrono::microseconds(us));
+}
+
+void pinMode(uint8_t pin, uint8_t mode){
+}
+
+void digitalWrite(uint8_t pin, uint8_t value){
+	if (pin < HOST_PIN_COUNT){
+		digital_outputs[pin] = value != 0;
+	}
+}
+
+int digitalRead(uint8_t pin){
+	return pin < HOST_PIN_COUNT ? digital_inputs[pin].load() : 0;
+}
+
+uint16_t analogRead(uint8_t pin){
+	if (pin >= HOST_PIN_COUNT){
+		return 0;
+	}
+	//inputs are set as 12 bit values
+	return analog_resolution >= 12 ? analog_inputs[pin].load() << (analog_resolution - 12) : analog_inputs[pin].load() >> (12 - analog_resolution);
+}
+
+void analogReadResolution(uint8_t bits){
+	analog_resolution = bits;
+}
+
+void dacWrite(uint8_t pin, uint8_t value){
+	if (pin < HOST_PIN_COUNT){
+		dac_outputs[pin] = value;
+	}
+}
+
+long map(long x, long in_min, long in_max, long out_min, long out_max){
+	return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+void host_analog_input(uint8_t pin, uint16_t value){
+	if (pin < HOST_PIN_COUNT){
+		analog_inputs[pin] = value;
+	}
+}
+
+void host_digital_input(uint8_t pin, uint8_t value){
+	if (pin < HOST_PIN_COUNT){
+		digital_inputs[pin] = value != 0;
+	}
+}
+
+uint8_t host_dac_output(uint8_t pin){
+	return pin < HOST_PIN_COUNT ? dac_outputs[pin].load() : 0;
+}
+
+uint8_t host_digital_output(uint8_t pin){
+	return pin < HOST_PIN_COUNT ? digital_outputs[pin].load() : 0;
+}
+
+
+void HardwareSerial::begin(unsigned long baud){
+}
+
+size_t HardwareSerial::print(const char *text){
+	return fputs(text, stdout) < 0 ? 0 : strlen(text);
+}
+
+size_t HardwareSerial::println(const char *text){
+	return this->print(text) + this->print("\r\n");
+}
+
+size_t HardwareSerial::printf(const char *format, ...){
+	va_list args;
+	va_start(args, format);
+	int written = vprintf(format, args);
+	va_end(args);
+	return written < 0 ? 0 : written;
+}
+
+
+//tasks run forever on the ESP32, the threads are detached and end with the process
+BaseType_t xTaskCreate(TaskFunction_t task_function, const char *name, uint32_t stack_depth, void *param, UBaseType_t priority, TaskHandle_t *handle){
+	thread(task_function, param).detach();
+	if (handle != NULL){
+		*handle = NULL;
+	}
+	return pdPASS;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task_function, const char *name, uint32_t stack_depth, void *param, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core_id){
+	return xTaskCreate(task_function, name, stack_depth, param, priority, handle);
+}
+
+void vTaskDelay(TickType_t ticks){
+	this_thread::sleep_for(chrono::milliseconds(ticks * portTICK_PERIOD_MS));
+}
+
+//absolute deadline on the tick clock, a deadline in the past returns right away (like FreeRTOS)
+void vTaskDelayUntil(TickType_t *previous_wake_time, TickType_t time_increment){
+	*previous_wake_time += time_increment;
+	this_thread::sleep_until(host_start + chrono::milliseconds((uint64_t)*previous_wake_time * portTICK_PERIOD_MS));
+}
+
+void vTaskDelete(TaskHandle_t handle){
+}
+
+TickType_t xTaskGetTickCount(void){
+	return millis() / portTICK_PERIOD_MS;
+}
+
+
+IPAddress::IPAddress(){
+	memset(this->octets, 0, sizeof(this->octets));
+}
+
+IPAddress::IPAddress(uint8_t first_octet, uint8_t second_octet, uint8_t third_octet, uint8_t fourth_octet){
+	this->octets[0] = first_octet;
+	this->octets[1] = second_octet;
+	this->octets[2] = third_octet;
+	this->octets[3] = fourth_octet;
+}
+
+uint32_t IPAddress::to_network(void) const{
+	uint32_t address;
+	memcpy(&address, this->octets, 4);
+	return address;
+}
+
+
+WiFiClass::WiFiClass() : event_callback(NULL) {}
+
+void WiFiClass::onEvent(WiFiEventCb callback){
+	this->event_callback = callback;
+}
+
+bool WiFiClass::config(IPAddress local_ip, IPAddress gateway, IPAddress subnet){
+	//the host keeps its own addresses
+	return true;
+}
+
+int WiFiClass::begin(const char *ssid, const char *passphrase){
+	if (this->event_callback != NULL){
+		this->event_callback(SYSTEM_EVENT_STA_CONNECTED);
+	}
+	return 0;
+}
+
+bool WiFiClass::disconnect(bool wifioff){
+	return true;
+}
+
+IPAddress WiFiClass::localIP(void){
+	return IPAddress(127, 0, 0, 1);
+}
+
+
+WiFiUDP::WiFiUDP() : udp_socket(-1), rx_length(0), rx_position(0), tx_length(0), tx_address(0), tx_port(0) {}
+
+WiFiUDP::~WiFiUDP(){
+	this->stop();
+}
+
+int WiFiUDP::begin_socket(uint16_t port){
+	this->stop();
+	this->udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+	if (this->udp_socket < 0){
+		return 0;
+	}
+	int enable = 1;
+	setsockopt(this->udp_socket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+	setsockopt(this->udp_socket, SOL_SOCKET, SO_BROADCAST, &enable, sizeof(enable));
+
+	sockaddr_in local_address;
+	memset(&local_address, 0, sizeof(local_address));
+	local_address.sin_family = AF_INET;
+	local_address.sin_addr.s_addr = htonl(INADDR_ANY);
+	local_address.sin_port = htons(port);
+	if (bind(this->udp_socket, (sockaddr *)&local_address, sizeof(local_address)) < 0){
+		perror("WiFiUDP: bind");
+		this->stop();
+		return 0;
+	}
+	//parsePacket() must not block, like lwIP in the firmware
+	fcntl(this->udp_socket, F_SETFL, fcntl(this->udp_socket, F_GETFL, 0) | O_NONBLOCK);
+	return 1;
+}
+
+uint8_t WiFiUDP::begin(uint16_t port){
+	return this->begin_socket(port);
+}
+
+uint8_t WiFiUDP::beginMulticast(IPAddress multicast_ip, uint16_t port){
+	if (!this->begin_socket(port)){
+		return 0;
+	}
+	ip_mreq membership;
+	membership.imr_multiaddr.s_addr = multicast_ip.to_network();
+	membership.imr_interface.s_addr = htonl(INADDR_ANY);
+	if (setsockopt(this->udp_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0){
+		perror("WiFiUDP: IP_ADD_MEMBERSHIP");
+	}
+	return 1;
+}
+
+void WiFiUDP::stop(void){
+	if (this->udp_socket >= 0){
+		close(this->udp_socket);
+		this->udp_socket = -1;
+	}
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port){
+	addrinfo hints;
+	addrinfo *result;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(host, NULL, &hints, &result) != 0){
+		return 0;
+	}
+	this->tx_address = ((sockaddr_in *)result->ai_addr)->sin_addr.s_addr;
+	freeaddrinfo(result);
+	this->tx_port = port;
+	this->tx_length = 0;
+	return 1;
+}
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port){
+	this->tx_address = ip.to_network();
+	this->tx_port = port;
+	this->tx_length = 0;
+	return 1;
+}
+
+size_t WiFiUDP::write(uint8_t data){
+	return this->write(&data, 1);
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size){
+	if (size > HOST_UDP_BUFFER_SIZE - this->tx_length){
+		size = HOST_UDP_BUFFER_SIZE - this->tx_length;
+	}
+	memcpy(this->tx_buffer + this->tx_length, buffer, size);
+	this->tx_length += size;
+	return size;
+}
+
+int WiFiUDP::endPacket(void){
+	if (this->udp_socket < 0){
+		return 0;
+	}
+	sockaddr_in destination;
+	memset(&destination, 0, sizeof(destination));
+	destination.sin_family = AF_INET;
+	destination.sin_addr.s_addr = this->tx_address;
+	destination.sin_port = htons(this->tx_port);
+	ssize_t sent = sendto(this->udp_socket, this->tx_buffer, this->tx_length, 0, (sockaddr *)&destination, sizeof(destination));
+	this->tx_length = 0;
+	return sent < 0 ? 0 : 1;
+}
+
+int WiFiUDP::parsePacket(void){
+	//the rest of the previous datagram is dropped, as in the ESP32 library
+	this->rx_length = 0;
+	this->rx_position = 0;
+	if (this->udp_socket < 0){
+		return 0;
+	}
+	ssize_t received = recv(this->udp_socket, this->rx_buffer, HOST_UDP_BUFFER_SIZE, 0);
+	if (received <= 0){
+		return 0;
+	}
+	this->rx_length = (int)received;
+	return this->rx_length;
+}
+
+int WiFiUDP::available(void){
+	return this->rx_length - this->rx_position;
+}
+
+int WiFiUDP::read(void){
+	return this->available() > 0 ? this->rx_buffer[this->rx_position++] : -1;
+}
+
+int WiFiUDP::read(unsigned char *buffer, size_t len){
+	int count = this->available() < (int)len ? this->available() : (int)len;
+	memcpy(buffer, this->rx_buffer + this->rx_position, count);
+	this->rx_position += count;
+	return count;
+}
+
+int WiFiUDP::read(char *buffer, size_t len){
+	return this->read((unsigned char *)buffer, len);
+}
+
+size_t WiFiUDP::readBytes(char *buffer, size_t length){
+	return this->read(buffer, length);
+}
+
+void WiFiUDP::flush(void){
+}
+
+
+//reflected CRC32 (0xEDB88320), start value and final value inverted
+CRC32::CRC32(){
+	this->reset();
+}
+
+void CRC32::reset(void){
+	this->state = 0xFFFFFFFF;
+}
+
+void CRC32::update(uint8_t data){
+	this->state ^= data;
+	for (int bit = 0; bit < 8; bit++){
+		this->state = (this->state >> 1) ^ (0xEDB88320 & (0 - (this->state & 1)));
+	}
+}
+
+void CRC32::update(const void *data, size_t size){
+	const uint8_t *bytes = (const uint8_t *)data;
+	for (size_t i = 0; i < size; i++){
+		this->update(bytes[i]);
+	}
+}
+
+uint32_t CRC32::finalize(void) const{
+	return ~this->state;
+}
+
+uint32_t CRC32::calculate(const void *data, size_t size){
+	CRC32 crc;
+	crc.update(data, size);
+	return crc.finalize();
+}
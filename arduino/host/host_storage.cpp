@@ -0,0 +1,40 @@
+/************************************************************************************/
+// host_storage.cpp
+// Content: host implementation of the persistent key/value store (storage.h)
+// one file per key in the working directory: host_storage_<key>.bin
+// delete the files to simulate a factory fresh device
+/************************************************************************************/
+
+#include <stdio.h>
+#include <string>
+
+#include "storage.h"
+
+static std::string storage_path(const char *key){
+	return std::string("host_storage_") + key + ".bin";
+}
+
+bool storage_read(const char *key, void *data, size_t length){
+	FILE *file = fopen(storage_path(key).c_str(), "rb");
+	if (file == NULL){
+		return false;
+	}
+	size_t read_length = fread(data, 1, length, file);
+	//more bytes stored than asked for is a different record
+	bool exact = read_length == length && fgetc(file) == EOF;
+	fclose(file);
+	return exact;
+}
+
+bool storage_write(const char *key, const void *data, size_t length){
+	//written to a temporary file and renamed, a killed host process leaves the old record intact (like NVS)
+	std::string path = storage_path(key);
+	std::string temporary_path = path + ".tmp";
+	FILE *file = fopen(temporary_path.c_str(), "wb");
+	if (file == NULL){
+		return false;
+	}
+	bool written = fwrite(data, 1, length, file) == length;
+	written = (fclose(file) == 0) && written;
+	return written && rename(temporary_path.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,173 @@
+/************************************************************************************/
+// restart_check.cpp
+// Content: replays transmitter reboots against the udpserver (CommTransmitter) on loopback
+// a transmitter sends protocol v2 live data and answers the clock pings, reboots before
+// its counter got far (sequence and micros() start over) and reboots again after a short uptime
+// the first packet after a reboot has to reach the live state, none may count as reordered,
+// and the clock estimate must not mix exchanges of before and after the reboot
+// exits with 1 on the first failed expectation, neither the udpserver nor the host firmware may be running
+/************************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+
+#include "CommTransmitter.h"
+#include "Crc32.h"
+
+//LISTEN_PORT and TRANSMITTER_PORT of CommTransmitter.cpp
+#define SERVER_PORT			3333
+#define DEVICE_PORT			31337
+#define SERVER_ADDRESS		"127.0.0.1"
+//send interval of the replayed live data, the server has to keep up
+#define SEND_INTERVAL_US	1000
+//the server takes the datagrams from its socket in another thread
+#define SETTLE_MS			50
+//a clock estimate this far off the replayed micros() is one of the old boot
+#define CLOCK_TOLERANCE_US	20000
+
+//the replayed transmitter, its micros() is the steady clock of this process since boot plus boot_us
+struct s_device{
+	std::chrono::steady_clock::time_point boot;
+	uint32_t boot_us;
+	uint32_t sequence;
+	unsigned int pongs; //since boot
+};
+
+static uint32_t seal_crc(const void *data, size_t length){
+	return crc32_fast(data, length);
+}
+
+static void device_boot(s_device &device, uint32_t boot_us){
+	device.boot = std::chrono::steady_clock::now();
+	device.boot_us = boot_us;
+	device.sequence = 0;
+	device.pongs = 0;
+}
+
+static uint32_t device_micros(const s_device &device){
+	return device.boot_us + (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - device.boot).count();
+}
+
+//answers the clock pings the server sent meanwhile, everything else it sends is ignored
+static void serve_pings(UDPSocket &sock, s_device &device){
+	uint8_t buffer[RECV_BUFFER_SIZE];
+	string source_address;
+	unsigned short source_port;
+	while (sock.hasPendingDatagram()){
+		int length = sock.recvFrom(buffer, sizeof(buffer), source_address, source_port);
+		protocol_view<s_clock_ping> ping(buffer, length);
+		if (!ping.valid(seal_crc)){
+			continue;
+		}
+		s_clock_pong pong;
+		memset(&pong, 0, sizeof(pong));
+		pong.type = TRANSMITTER_FRAME_CLOCK_PONG;
+		pong.server_tx_us = ping->server_tx_us;
+		pong.device_rx_us = device_micros(device);
+		pong.device_tx_us = device_micros(device);
+		protocol_seal(pong, seal_crc);
+		sock.sendTo(&pong, sizeof(pong), SERVER_ADDRESS, SERVER_PORT);
+		device.pongs++;
+	}
+}
+
+//count packets one interval apart, the last one carries last_throttle
+static void send_states(UDPSocket &sock, s_device &device, int count, uint8_t last_throttle){
+	for (int i = 1; i <= count; i++){
+		s_transmitter_state_packet_v2 packet;
+		memset(&packet, 0, sizeof(packet));
+		packet.type = TRANSMITTER_FRAME_STATE_V2;
+		packet.sequence = ++device.sequence;
+		packet.timestamp_us = device_micros(device);
+		packet.state.in_throttle = (i == count) ? last_throttle : (uint8_t)i;
+		protocol_seal(packet, seal_crc);
+		sock.sendTo(&packet, sizeof(packet), SERVER_ADDRESS, SERVER_PORT);
+		std::this_thread::sleep_for(std::chrono::microseconds(SEND_INTERVAL_US));
+		serve_pings(sock, device);
+	}
+}
+
+static bool expect_state(CommTransmitter &server, const char *phase, int in_throttle){
+	std::this_thread::sleep_for(std::chrono::milliseconds(SETTLE_MS));
+	int live = server.get_in_throttle(SERVER_ADDRESS);
+	s_link_stats stats;
+	if (server.get_link_stats(SERVER_ADDRESS, stats) != 0){
+		printf("%s: no link stats\r\n", phase);
+		return false;
+	}
+	if (live != in_throttle){
+		printf("%s: live in_throttle %d, sent %d\r\n", phase, live, in_throttle);
+		return false;
+	}
+	if (stats.packets_reordered != 0 || stats.packets_lost != 0){
+		printf("%s: %llu reordered, %llu lost\r\n", phase, stats.packets_reordered, stats.packets_lost);
+		return false;
+	}
+	return true;
+}
+
+//only exchanges of the current boot may be fitted, and now has to map onto now
+static bool expect_clock(CommTransmitter &server, const char *phase, const s_device &device){
+	s_clock_stats stats;
+	if (server.get_clock_stats(SERVER_ADDRESS, stats) != 0){
+		printf("%s: clock not synchronized (%u pongs)\r\n", phase, device.pongs);
+		return false;
+	}
+	if (stats.samples > device.pongs){
+		printf("%s: %u clock exchanges fitted, %u since the reboot\r\n", phase, stats.samples, device.pongs);
+		return false;
+	}
+	chrono::steady_clock::time_point mapped;
+	uint32_t device_now_us = device_micros(device);
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (server.to_server_time(SERVER_ADDRESS, device_now_us, mapped) != 0){
+		printf("%s: no server time\r\n", phase);
+		return false;
+	}
+	long long error_us = chrono::duration_cast<chrono::microseconds>(mapped - now).count();
+	if (error_us > CLOCK_TOLERANCE_US || error_us < -CLOCK_TOLERANCE_US){
+		printf("%s: transmitter time maps %lld us off\r\n", phase, error_us);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]){
+	CommTransmitter &server(CommTransmitter::_getInstance());
+	UDPSocket sock(DEVICE_PORT);
+	s_device device;
+
+	//up for a minute, then the first reboot after 900 packets - below SEQUENCE_RESTART_GAP
+	device_boot(device, 60000000);
+	send_states(sock, device, 900, 201);
+	if (!expect_state(server, "boot", 201) || !expect_clock(server, "boot", device)){
+		return 1;
+	}
+
+	//micros() started over
+	device_boot(device, 800000);
+	send_states(sock, device, 1, 202);
+	if (!expect_state(server, "first packet after the reboot", 202)){
+		return 1;
+	}
+	send_states(sock, device, 300, 203);
+	if (!expect_state(server, "after the reboot", 203) || !expect_clock(server, "after the reboot", device)){
+		return 1;
+	}
+
+	//rebooted after a short uptime, micros() does not go back
+	device_boot(device, device_micros(device) + 500000);
+	send_states(sock, device, 1, 204);
+	if (!expect_state(server, "first packet after the short reboot", 204)){
+		return 1;
+	}
+	send_states(sock, device, 300, 205);
+	if (!expect_state(server, "after the short reboot", 205) || !expect_clock(server, "after the short reboot", device)){
+		return 1;
+	}
+
+	printf("transmitter reboots detected, live state and clock follow the new boot\r\n");
+	return 0;
+}
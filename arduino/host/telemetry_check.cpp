@@ -0,0 +1,90 @@
+/************************************************************************************/
+// telemetry_check.cpp
+// Content: send-on-change triggers of the comm task against the running HAL task
+// the sticks rest, so after the last sent packet nothing is due until the heartbeat
+// pressing and releasing the button has to make a packet due right away
+// exits with 1 on the first failed expectation
+/************************************************************************************/
+
+#include <stdio.h>
+#include <thread>
+#include <chrono>
+
+#include "Arduino.h"
+#include "defines.h"
+#include "channels.h"
+#include "transmitter_hal.h"
+
+//live data transmission state of comm.cpp
+extern uint8_t telemetry_mode;
+extern uint16_t telemetry_heartbeat_ms;
+extern bool telemetry_raw;
+extern uint64_t last_telemetry_millis;
+extern s_transmitter_channels last_sent_channels;
+extern s_transmitter_channels current_channels;
+bool telemetry_due(void);
+
+#define CHECK_CENTER		2048
+//~3.7V behind the voltage divider, 12 bit
+#define CHECK_BATTERY		2300
+//input settling and filter of the HAL
+#define CHECK_SETTLE_MS		1000
+//a few HAL loops
+#define CHECK_EDGE_MS		50
+//the heartbeat must not be what makes a packet due
+#define CHECK_HEARTBEAT_MS	60000
+
+//what the comm task does once per tick, then the packet is sent (or not)
+static bool comm_tick(bool &due){
+	transmitter_channels.read(current_channels);
+	due = telemetry_due();
+	if (due){
+		last_telemetry_millis = millis();
+		last_sent_channels = current_channels;
+	}
+	return due;
+}
+
+static bool expect_edge(const char *phase, uint8_t button){
+	bool due;
+	host_digital_input(BUTTON_SENSE_PIN, button);
+	std::this_thread::sleep_for(std::chrono::milliseconds(CHECK_EDGE_MS));
+	comm_tick(due);
+	if (!due || current_channels.in_button != button){
+		printf("%s: in_button %d, packet %s\r\n", phase, current_channels.in_button, due ? "due" : "not due");
+		return false;
+	}
+	//sent, the button holds still now
+	std::this_thread::sleep_for(std::chrono::milliseconds(CHECK_EDGE_MS));
+	if (comm_tick(due)){
+		printf("%s: packet due again without a change\r\n", phase);
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[]){
+	for (int channel = 0; channel < CHANNEL_COUNT; channel++){
+		host_analog_input(channel_table[channel].sense_pin, CHECK_CENTER);
+	}
+	host_analog_input(BATTERY_VOLTAGE_SENSE, CHECK_BATTERY);
+	host_digital_input(BUTTON_SENSE_PIN, 0);
+	start_transmitter_hal();
+	std::this_thread::sleep_for(std::chrono::milliseconds(CHECK_SETTLE_MS));
+
+	telemetry_mode = TELEMETRY_MODE_ON_CHANGE;
+	telemetry_heartbeat_ms = CHECK_HEARTBEAT_MS;
+	telemetry_raw = false;
+	bool due;
+	comm_tick(due);
+	if (comm_tick(due)){
+		printf("resting sticks: packet due without a change\r\n");
+		return 1;
+	}
+
+	if (!expect_edge("button pressed", 1) || !expect_edge("button released", 0)){
+		return 1;
+	}
+	printf("button edges make a send-on-change packet due\r\n");
+	return 0;
+}
@@ -10,6 +10,16 @@
 #include <map>
 #include <list>
 #include <mutex>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <time.h>
+#endif
 
 using namespace std;
 
@@ -19,11 +29,104 @@ mutex queue_mutex;
 
 #define TRANSMITTER_PORT		31337
 
-#define TRANSMITTER_DELETE_AGE_MS	10
-#define TRANSMITTER_DISABLE_AGE_MS	3
+//transmitters are disabled after TRANSMITTER_DISABLE_AGE_MS without live data and removed after TRANSMITTER_DELETE_AGE_MS
+#define TRANSMITTER_DELETE_AGE_MS	10000
+#define TRANSMITTER_DISABLE_AGE_MS	300
+//a transmitter may be silent for this many heartbeats (send-on-change) or send periods (periodic) on top
+#define TRANSMITTER_MISSED_HEARTBEATS	3
+//live data configuration is resent this often
+#define TELEMETRY_CONFIG_RESEND_MS	1000
+
+//default interval all transmitters share for one round of paced overrides
+#define PACING_INTERVAL_US		5000
+//how long the sender thread sleeps if there is nothing to pace
+#define SENDER_IDLE_WAIT_MS		100
+
+//nominal telemetry rate of the transmitters (PACKETS_PER_SECOND in the firmware)
+#define TRANSMITTER_PACKETS_PER_SECOND	100
+//telemetry loss is measured over windows of this length...
+#define LOSS_WINDOW_MS			1000
+//...and smoothed with this weight of the newest window
+#define LOSS_FILTER_WEIGHT		0.5
+//redundancy is chosen so that all copies of an override are lost at most this probable
+#define REDUNDANCY_TARGET_LOSS		0.001
+//defaults for redundant override transmission
+#define REDUNDANCY_MAX_COPIES		4
+#define REDUNDANCY_GAP_US		1000
+
+//trajectory playback waits in slices of this length to stay responsive to stop_trajectories()
+#define TRAJECTORY_WAIT_SLICE_US	100000
+//without timerfd the last part of the wait is spent spinning to get below the scheduler granularity
+#define TRAJECTORY_SPIN_US		2000
+//resolution of the trajectory send error histogram
+#define TRAJECTORY_ERROR_BUCKET_US	10
+#define TRAJECTORY_ERROR_BUCKETS	1000
+
+//overrides not seen applied within the firmware override validity are counted as timed out
+#define APPLY_TIMEOUT_MS		500
+
+//a sequence number this far behind the highest one seen means the transmitter restarted
+#define SEQUENCE_RESTART_GAP		1000
+//so does a transmitter timestamp this far behind the newest one (micros() started over),
+//late packets and pongs are a few periods old at most
+#define DEVICE_RESTART_BACKSTEP_US	1000000
+//history of the duplicate detection in packets, one bit each
+#define SEQUENCE_WINDOW_SIZE		64
+
+//clock synchronization, ping interval and number of exchanges kept for the estimate
+#define CLOCK_SYNC_INTERVAL_MS		250
+#define CLOCK_SYNC_SAMPLES		32
+//only the exchanges with the shortest round trips are used, queueing delays make the others asymmetric
+#define CLOCK_SYNC_BEST_FRACTION	0.25
+
+//raw ADC live data, a channel is scaled as if it spans at least this much around the center until the stick explored it
+#define RAW_CALIBRATION_MIN_RANGE	500
+#define RAW_ADC_MAX				4095
+
+//black box fetch, a chunk is asked for again if it did not arrive within the timeout
+#define BLACKBOX_CHUNK_TIMEOUT_MS	100
+#define BLACKBOX_REQUEST_ATTEMPTS	5
+
+//group overrides go to the broadcast address of the transmitter network by default
+#define GROUP_OVERRIDE_ADDRESS	"192.168.0.255"
 
 CommTransmitter* CommTransmitter::_pInstance = NULL;
 
+//CRC32 of a frame, for the protocol views (a function pointer does not take the default argument of crc32_fast)
+//the spans of the small fixed size frames go to the unrolled kernels, they stay off the 16 KB table of crc32_fast
+//the views pass their span as a constant, so the switch folds away where frame_crc is inlined
+static uint32_t frame_crc(const void *data, size_t length){
+	switch (length){
+	case 2: //control v1
+		return crc32_fixed<2>(data);
+	case 4: //blackbox request
+		return crc32_fixed<4>(data);
+	case 8: //state v1, control v2, telemetry config
+		return crc32_fixed<8>(data);
+	case 12: //clock ping
+		return crc32_fixed<12>(data);
+	case 20: //state v2, clock pong
+		return crc32_fixed<20>(data);
+	default:
+		return crc32_fast(data, length);
+	}
+}
+
+//the bitmap of crc32_verify_frames covers a whole receive batch
+static_assert(RECV_BATCH_MAX <= CRC32_VERIFY_MAX_FRAMES, "RECV_BATCH_MAX: more datagrams than crc32_verify_frames checks");
+static_assert(RECV_GATHER_STRIDE >= ((protocol_frame<s_transmitter_state_packet_v2>::size + 15) & ~15), "RECV_GATHER_STRIDE: the CRC lanes read past a gathered v2 frame");
+static_assert(RECV_GATHER_STRIDE >= ((protocol_frame<s_transmitter_state_packet>::size + 15) & ~15), "RECV_GATHER_STRIDE: the CRC lanes read past a gathered v1 frame");
+
+//live state fields of a frame into a history sample
+static void copy_state(s_state_sample &sample, const s_transmitter_state &state){
+	sample.in_throttle = state.in_throttle;
+	sample.in_steer = state.in_steer;
+	sample.in_button = state.in_button;
+	sample.out_throttle = state.out_throttle;
+	sample.out_steer = state.out_steer;
+	sample.battery_voltage_mv = state.battery_voltage_mv;
+}
+
 CommTransmitter& CommTransmitter::_getInstance(){
 	if (NULL == _pInstance){
 		_pInstance = new CommTransmitter();
@@ -37,16 +140,38 @@ void CommTransmitter::_destroyInstance(){
 }
 
 CommTransmitter::CommTransmitter():
+	raw_channels_dirty(false),
 	monotonic_counter(0),
 	running(false),
 	stop(true),
 	listen_port(LISTEN_PORT),
 	sock(new UDPSocket(this->listen_port)),
-	th(thread(&CommTransmitter::run, this)){
+	pacing_enabled(false),
+	pacing_interval(PACING_INTERVAL_US),
+	pacing_next_slot(chrono::steady_clock::now()),
+	paced_sends(0),
+	paced_queue_delay_sum_us(0),
+	paced_queue_delay_max_us(0),
+	sender_stop(false),
+	redundancy_enabled(false),
+	redundancy_max_copies(REDUNDANCY_MAX_COPIES),
+	redundancy_gap(REDUNDANCY_GAP_US),
+	trajectory_stop(false),
+	trajectory_playing(false),
+	trajectory_send_error(TRAJECTORY_ERROR_BUCKET_US, TRAJECTORY_ERROR_BUCKETS),
+	group_address(GROUP_OVERRIDE_ADDRESS),
+	th(thread(&CommTransmitter::run, this)),
+	sender_th(thread(&CommTransmitter::run_sender, this)){
 
 }
 
 CommTransmitter::~CommTransmitter(){
+	this->stop_trajectories();
+	queue_mutex.lock();
+	this->sender_stop = true;
+	queue_mutex.unlock();
+	this->sender_condition.notify_all();
+	this->sender_th.join();
 	delete this->sock;
 }
 
@@ -74,8 +199,10 @@ const int CommTransmitter::set_override_out_both(string transmitter_ip, unsigned
 			my_t_o.ip_address = transmitter_ip;
 			my_t_o.ts_ct_packet.out_steer = new_steer;
 			my_t_o.ts_ct_packet.out_throttle = new_throttle;
-			this->transmitter_override_queue.push_back(my_t_o);
+			my_t_o.queued_at = chrono::steady_clock::now();
+			this->queue_override(my_t_o);
 			queue_mutex.unlock();
+			this->sender_condition.notify_one();
 			return 0;
 		}
 	}
@@ -96,8 +223,10 @@ const int CommTransmitter::set_override_out_steer(string transmitter_ip, unsigne
 			my_t_o.override_steer = true;
 			my_t_o.ip_address = transmitter_ip;
 			my_t_o.ts_ct_packet.out_steer = new_steer;
-			this->transmitter_override_queue.push_back(my_t_o);
+			my_t_o.queued_at = chrono::steady_clock::now();
+			this->queue_override(my_t_o);
 			queue_mutex.unlock();
+			this->sender_condition.notify_one();
 			return 0;
 		}
 	}
@@ -118,8 +247,10 @@ const int CommTransmitter::set_override_out_throttle(string transmitter_ip, unsi
 			my_t_o.override_throttle = true;
 			my_t_o.ip_address = transmitter_ip;
 			my_t_o.ts_ct_packet.out_throttle = new_throttle;
-			this->transmitter_override_queue.push_back(my_t_o);
+			my_t_o.queued_at = chrono::steady_clock::now();
+			this->queue_override(my_t_o);
 			queue_mutex.unlock();
+			this->sender_condition.notify_one();
 			return 0;
 		}
 	}
@@ -152,6 +283,7 @@ const int CommTransmitter::get_out_steer(string transmitter_ip){
 		}
 	}
 	//not found...
+	queue_mutex.unlock();
 	return -1;
 }
 
@@ -185,19 +317,30 @@ const int CommTransmitter::get_in_throttle(string transmitter_ip){
 
 
 void CommTransmitter::cleanup_transmitter_list(){
-	std::chrono::duration<double, std::nano> update_age;
+	std::chrono::duration<double, std::milli> update_age;
 	queue_mutex.lock();
 
 	for (map <string, Transmitter>::iterator ct_iter = this->connected_transmitters.begin(); ct_iter != this->connected_transmitters.end(); ct_iter++){
-		update_age = ct_iter->second.last_packet_received - chrono::high_resolution_clock::now();
+		update_age = chrono::steady_clock::now() - ct_iter->second.last_packet_received;
 		//cout << update_age.count() << endl;
-		if (update_age.count() > TRANSMITTER_DELETE_AGE_MS){
+
+		//idle transmitters in send-on-change mode only send their heartbeat, slow periodic ones
+		//(below ~4 pps) leave gaps longer than TRANSMITTER_DISABLE_AGE_MS between two packets
+		double heartbeat_allowance_ms = 0;
+		if (ct_iter->second.telemetry_configured && ct_iter->second.telemetry_config.mode == TELEMETRY_MODE_ON_CHANGE){
+			heartbeat_allowance_ms = TRANSMITTER_MISSED_HEARTBEATS * ct_iter->second.telemetry_config.heartbeat_ms;
+		}
+		else if (ct_iter->second.telemetry_configured){
+			heartbeat_allowance_ms = TRANSMITTER_MISSED_HEARTBEATS * 1000.0 / ct_iter->second.telemetry_config.packets_per_second;
+		}
+
+		if (update_age.count() > TRANSMITTER_DELETE_AGE_MS + heartbeat_allowance_ms){
 			cout << "removing transmitter with IP: " << ct_iter->second.ip_address << endl;
 			this->connected_transmitters.erase(ct_iter->second.ip_address);
 			//we shortened the list, should not be a problem... but we are called soon again anyway so breaking here and wait for our next call is no problem.
 			break;
 		}
-		if (update_age.count() > TRANSMITTER_DISABLE_AGE_MS){
+		if (update_age.count() > TRANSMITTER_DISABLE_AGE_MS + heartbeat_allowance_ms && ct_iter->second.alive){
 			//seen no updates for TRANSMITTER_DISABLE_AGE_MS - disable and prevent showing up on public functions
 			cout << "disabling transmitter with IP: " << ct_iter->second.ip_address << endl;
 			ct_iter->second.alive = false;
@@ -207,14 +350,1237 @@ void CommTransmitter::cleanup_transmitter_list(){
 	queue_mutex.unlock();
 }
 
+void CommTransmitter::send_override(TransmitterOverride &t_o){
+	//queue_mutex has to be held by the caller
+	//check whether steering or throttle shall NOT be overridden - replace the unset value with the last read live value
+	if (t_o.override_steer == false){
+		//it is IN_STEER - NOT OUT_STEER - elsewise we would fix up the last sent value!!!
+		//in_steer is the value read from the ADC, out_steer would be the value we sent now and from there on to forever...
+		//if you don't understand this, ask. 
+		t_o.ts_ct_packet.out_steer = this->connected_transmitters[t_o.ip_address].ts_packet.in_steer;
+	}
+	//...
+	if (t_o.override_throttle == false){
+		//as above with steer, use tha transmitters IN value
+		//if you don't understand this, ask. 
+		t_o.ts_ct_packet.out_throttle = this->connected_transmitters[t_o.ip_address].ts_packet.in_throttle;
+	}
+
+	//redundant copies keep the sequence number, the transmitter applies the first one to arrive
+	t_o.ts_ct_packet.type = TRANSMITTER_FRAME_CONTROL_V2;
+	t_o.ts_ct_packet.reserved = 0;
+	t_o.ts_ct_packet.sequence = this->connected_transmitters[t_o.ip_address].control_sequence++;
+	protocol_seal(t_o.ts_ct_packet, frame_crc);
+	
+	this->send_control_packet(t_o.ts_ct_packet, t_o.ip_address);
+	this->track_override_sent(this->connected_transmitters[t_o.ip_address], t_o.ts_ct_packet.out_steer, t_o.ts_ct_packet.out_throttle);
+	//cout << (unsigned short)t_o.ts_ct_packet.out_steer << ":" << (unsigned short)t_o.ts_ct_packet.out_throttle << "(" << t_o.ts_ct_packet.CRC << ")" << endl;
+
+	this->schedule_redundant_copies(t_o);
+}
+
+void CommTransmitter::queue_override(const TransmitterOverride &t_o){
+	//queue_mutex has to be held by the caller
+	//while paced, an override still waiting for its slot takes the newer values of the same transmitter
+	//it keeps its place in the queue and its queued_at, so there is at most one queued override per transmitter
+	if (this->pacing_enabled){
+		for (list<TransmitterOverride>::iterator q_iter = this->transmitter_override_queue.begin(); q_iter != this->transmitter_override_queue.end(); q_iter++){
+			if (q_iter->ip_address == t_o.ip_address){
+				if (t_o.override_steer){
+					q_iter->override_steer = true;
+					q_iter->ts_ct_packet.out_steer = t_o.ts_ct_packet.out_steer;
+				}
+				if (t_o.override_throttle){
+					q_iter->override_throttle = true;
+					q_iter->ts_ct_packet.out_throttle = t_o.ts_ct_packet.out_throttle;
+				}
+				return;
+			}
+		}
+	}
+	this->transmitter_override_queue.push_back(t_o);
+}
+
+void CommTransmitter::send_control_packet(s_transmitter_control_packet_v2 &packet, const string &transmitter_ip){
+	try{
+		this->sock->sendTo(&packet, sizeof(s_transmitter_control_packet_v2), transmitter_ip, TRANSMITTER_PORT);
+	}
+	catch (const exception &ex){
+		cout << ex.what() << endl;
+	}
+}
+
+void CommTransmitter::schedule_redundant_copies(const TransmitterOverride &t_o){
+	//queue_mutex has to be held by the caller
+	//copies of an older override must not overtake the newer one - drop them
+	for (list <TransmitterOverride>::iterator rs_iter = this->redundant_send_queue.begin(); rs_iter != this->redundant_send_queue.end();){
+		if (rs_iter->ip_address == t_o.ip_address){
+			rs_iter = this->redundant_send_queue.erase(rs_iter);
+		}
+		else{
+			rs_iter++;
+		}
+	}
+
+	if (!this->redundancy_enabled){
+		return;
+	}
+
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	unsigned int copies = this->connected_transmitters[t_o.ip_address].redundancy;
+	for (unsigned int i = 1; i < copies; i++){
+		TransmitterOverride my_copy(t_o);
+		my_copy.send_at = now + this->redundancy_gap * i;
+
+		//keep the queue sorted, copies are mostly due after everything queued already
+		list <TransmitterOverride>::iterator rs_iter = this->redundant_send_queue.end();
+		while (rs_iter != this->redundant_send_queue.begin()){
+			list <TransmitterOverride>::iterator rs_prev = rs_iter;
+			rs_prev--;
+			if (rs_prev->send_at <= my_copy.send_at){
+				break;
+			}
+			rs_iter = rs_prev;
+		}
+		this->redundant_send_queue.insert(rs_iter, my_copy);
+	}
+	this->sender_condition.notify_one();
+}
+
+void CommTransmitter::update_loss_estimate(Transmitter &transmitter){
+	//queue_mutex has to be held by the caller
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	double window_ms = chrono::duration<double, std::milli>(now - transmitter.loss_window_start).count();
+
+	transmitter.loss_window_packets++;
+	if (window_ms < LOSS_WINDOW_MS){
+		return;
+	}
+
+	double window_loss;
+	if (!transmitter.sequence_valid && transmitter.telemetry_configured && transmitter.telemetry_config.mode == TELEMETRY_MODE_ON_CHANGE){
+		//no sequence numbers and no fixed rate - nothing to tell loss by, keep the last estimate
+		transmitter.loss_window_packets = 0;
+		transmitter.loss_window_start = now;
+		return;
+	}
+	if (transmitter.sequence_valid){
+		//protocol v2, the sequence numbers tell exactly what got lost (reordered packets are not lost)
+		double lost = (double)transmitter.packets_lost - (double)transmitter.loss_window_lost_base;
+		double received = (double)transmitter.packets_received - (double)transmitter.loss_window_received_base;
+		window_loss = (lost > 0 && lost + received > 0) ? lost / (lost + received) : 0;
+		transmitter.loss_window_lost_base = transmitter.packets_lost;
+		transmitter.loss_window_received_base = transmitter.packets_received;
+	}
+	else{
+		double packets_per_second = transmitter.telemetry_configured ? transmitter.telemetry_config.packets_per_second : TRANSMITTER_PACKETS_PER_SECOND;
+		double expected_packets = window_ms * packets_per_second / 1000.0;
+		window_loss = 1.0 - transmitter.loss_window_packets / expected_packets;
+	}
+	if (window_loss < 0){
+		window_loss = 0;
+	}
+	transmitter.loss_rate = (1.0 - LOSS_FILTER_WEIGHT) * transmitter.loss_rate + LOSS_FILTER_WEIGHT * window_loss;
+	transmitter.loss_window_packets = 0;
+	transmitter.loss_window_start = now;
+
+	//smallest number of copies that brings the chance of losing all of them below REDUNDANCY_TARGET_LOSS
+	//kept as double until clamped, towards a loss rate of 1 it grows beyond what an unsigned int holds
+	double copies = 1;
+	if (transmitter.loss_rate >= 1){
+		copies = this->redundancy_max_copies;
+	}
+	else if (transmitter.loss_rate > 0){
+		copies = ceil(log(REDUNDANCY_TARGET_LOSS) / log(transmitter.loss_rate));
+	}
+	if (copies < 1){
+		copies = 1;
+	}
+	if (copies > this->redundancy_max_copies){
+		copies = this->redundancy_max_copies;
+	}
+	transmitter.redundancy = (unsigned int)copies;
+}
+
+void CommTransmitter::track_override_sent(Transmitter &transmitter, uint8_t out_steer, uint8_t out_throttle){
+	//queue_mutex has to be held by the caller
+	//the firmware maps the throttle override with map(0..255 -> THROTTLE_MIN_OUT..THROTTLE_MAX_OUT) first, which is the identity
+	uint8_t expected_steer = protocol_dac_value(out_steer, TRANSMITTER_STEER_MIN_OUT, TRANSMITTER_STEER_CNT_OUT, TRANSMITTER_STEER_MAX_OUT);
+	uint8_t expected_throttle = protocol_dac_value(out_throttle, TRANSMITTER_THROTTLE_MIN_OUT, TRANSMITTER_THROTTLE_CNT_OUT, TRANSMITTER_THROTTLE_MAX_OUT);
+
+	if (transmitter.apply_pending
+		&& transmitter.apply_expected_out_steer == expected_steer
+		&& transmitter.apply_expected_out_throttle == expected_throttle){
+		//repeated override (redundancy, unchanged setpoint) - latency counts from the first one
+		return;
+	}
+	if (transmitter.ts_packet.out_steer == expected_steer && transmitter.ts_packet.out_throttle == expected_throttle){
+		//output is at these values already, we could not tell when the override is applied
+		transmitter.apply_pending = false;
+		return;
+	}
+	//a newer override replaces one not yet seen applied
+	transmitter.apply_pending = true;
+	transmitter.apply_sent_at = chrono::steady_clock::now();
+	transmitter.apply_expected_out_steer = expected_steer;
+	transmitter.apply_expected_out_throttle = expected_throttle;
+}
+
+void CommTransmitter::track_override_applied(Transmitter &transmitter){
+	//queue_mutex has to be held by the caller, ts_packet is the telemetry just received
+	if (!transmitter.apply_pending){
+		return;
+	}
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (transmitter.ts_packet.out_steer == transmitter.apply_expected_out_steer
+		&& transmitter.ts_packet.out_throttle == transmitter.apply_expected_out_throttle){
+		transmitter.apply_latency.add(chrono::duration<double, std::micro>(now - transmitter.apply_sent_at).count());
+		transmitter.apply_pending = false;
+	}
+	else if (now - transmitter.apply_sent_at > chrono::milliseconds(APPLY_TIMEOUT_MS)){
+		transmitter.apply_timeouts++;
+		transmitter.apply_pending = false;
+	}
+}
+
+const double CommTransmitter::get_apply_latency_percentile(string transmitter_ip, double percentile){
+	//latency in microseconds from sending an override to seeing it applied in the telemetry
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		double result = this->connected_transmitters[transmitter_ip].apply_latency.percentile(percentile);
+		queue_mutex.unlock();
+		return result;
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+const int CommTransmitter::get_apply_latency_histogram(string transmitter_ip, LatencyHistogram &histogram){
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		histogram = this->connected_transmitters[transmitter_ip].apply_latency;
+		queue_mutex.unlock();
+		return 0;
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+bool CommTransmitter::track_sequence(Transmitter &transmitter, uint32_t sequence, uint32_t timestamp_us){
+	//queue_mutex has to be held by the caller
+	//returns true if the packet is the newest one of this transmitter so far
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	int32_t delta = (int32_t)(sequence - transmitter.highest_sequence);
+	uint32_t age = transmitter.highest_sequence - sequence;
+	int32_t timestamp_step = (int32_t)(timestamp_us - transmitter.last_timestamp_us);
+
+	//the transmitter restarted counting if the sequence number is far behind, if micros() started over,
+	//or if the packet is behind the duplicate window but was sent after the newest one
+	//(a reboot within TRANSMITTER_DELETE_AGE_MS, before the old counter got past SEQUENCE_RESTART_GAP)
+	if (transmitter.sequence_valid
+		&& ((delta <= 0 && age > SEQUENCE_RESTART_GAP)
+		|| timestamp_step < -DEVICE_RESTART_BACKSTEP_US
+		|| (delta <= 0 && age >= SEQUENCE_WINDOW_SIZE && timestamp_step > 0))){
+		transmitter.sequence_valid = false;
+		this->reset_clock(transmitter);
+	}
+
+	if (!transmitter.sequence_valid){
+		transmitter.sequence_valid = true;
+		transmitter.highest_sequence = sequence;
+		transmitter.sequence_window = 1;
+		transmitter.packets_received++;
+		transmitter.last_arrival = now;
+		transmitter.last_timestamp_us = timestamp_us;
+		return true;
+	}
+
+	if (delta > 0){
+		//newest packet, everything skipped in between is lost until it shows up late
+		transmitter.packets_received++;
+		transmitter.packets_lost += delta - 1;
+		transmitter.sequence_window = (delta >= SEQUENCE_WINDOW_SIZE) ? 0 : transmitter.sequence_window << delta;
+		transmitter.sequence_window |= 1;
+		transmitter.highest_sequence = sequence;
+
+		//RFC 3550 interarrival jitter, transit time difference of consecutive packets
+		double arrival_diff_us = chrono::duration<double, std::micro>(now - transmitter.last_arrival).count();
+		double send_diff_us = (double)(int32_t)(timestamp_us - transmitter.last_timestamp_us);
+		double transit_diff_us = fabs(arrival_diff_us - send_diff_us);
+		transmitter.jitter_us += (transit_diff_us - transmitter.jitter_us) / 16.0;
+		transmitter.last_arrival = now;
+		transmitter.last_timestamp_us = timestamp_us;
+		return true;
+	}
+
+	if (age < SEQUENCE_WINDOW_SIZE && (transmitter.sequence_window & ((uint64_t)1 << age))){
+		transmitter.packets_duplicate++;
+		return false;
+	}
+	if (age < SEQUENCE_WINDOW_SIZE){
+		transmitter.sequence_window |= (uint64_t)1 << age;
+	}
+	//late packet, it was counted as lost before
+	transmitter.packets_received++;
+	transmitter.packets_reordered++;
+	if (transmitter.packets_lost > 0){
+		transmitter.packets_lost--;
+	}
+	return false;
+}
+
+bool CommTransmitter::parse_state_batch(int frame_len, uint32_t &sequence, uint32_t &timestamp_us){
+	//checks a batched live data frame in recv_buffer, fills received_samples and ts_packet with the newest sample
+	//the frame is read in place
+	protocol_table_view<s_transmitter_batch_header> frame(this->recv_buffer, frame_len);
+	if (!frame.has_header()){
+		return false;
+	}
+	const s_transmitter_batch_header *header = frame.header();
+	if (header->sample_count == 0 || !frame.valid(header->sample_count, frame_crc)){
+		return false;
+	}
+
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	for (int i = 0; i < header->sample_count; i++){
+		const s_transmitter_batch_sample *batch_sample = frame.entry(i);
+		s_state_sample my_sample;
+		my_sample.timestamp_us = header->base_timestamp_us + batch_sample->offset_us;
+		//the samples were taken before the frame was sent, estimate their arrival on the same timeline
+		my_sample.received = now - chrono::microseconds(header->send_offset_us - batch_sample->offset_us);
+		copy_state(my_sample, batch_sample->state);
+		this->received_samples.push_back(my_sample);
+	}
+
+	//newest sample is the live state
+	memcpy(&this->ts_packet, &frame.entry(header->sample_count - 1)->state, sizeof(s_transmitter_state));
+	this->ts_packet.CRC = frame.crc(header->sample_count);
+	sequence = header->sequence;
+	timestamp_us = header->base_timestamp_us + header->send_offset_us;
+	return true;
+}
+
+bool CommTransmitter::parse_state_channels(int frame_len, uint32_t &sequence, uint32_t &timestamp_us){
+	//checks a live data frame of all analog channels in recv_buffer, fills received_channels and ts_packet
+	//the frame is read in place
+	protocol_table_view<s_transmitter_channels_header> frame(this->recv_buffer, frame_len);
+	if (!frame.has_header()){
+		return false;
+	}
+	const s_transmitter_channels_header *header = frame.header();
+	//throttle and steering are always there, they stay the live state
+	if (header->channel_count <= TRANSMITTER_CHANNEL_STEER || !frame.valid(header->channel_count, frame_crc)){
+		return false;
+	}
+
+	for (int i = 0; i < header->channel_count; i++){
+		this->received_channels.push_back(*frame.entry(i));
+	}
+
+	this->ts_packet.in_throttle = frame.entry(TRANSMITTER_CHANNEL_THROTTLE)->in;
+	this->ts_packet.out_throttle = frame.entry(TRANSMITTER_CHANNEL_THROTTLE)->out;
+	this->ts_packet.in_steer = frame.entry(TRANSMITTER_CHANNEL_STEER)->in;
+	this->ts_packet.out_steer = frame.entry(TRANSMITTER_CHANNEL_STEER)->out;
+	this->ts_packet.in_button = header->in_button;
+	this->ts_packet.battery_voltage_mv = header->battery_voltage_mv;
+	this->ts_packet.CRC = frame.crc(header->channel_count);
+	sequence = header->sequence;
+	timestamp_us = header->timestamp_us;
+	return true;
+}
+
+bool CommTransmitter::parse_state_raw(int frame_len, uint32_t &sequence, uint32_t &timestamp_us){
+	//checks a raw ADC live data frame in recv_buffer, fills received_raw, received_channels and ts_packet
+	//the frame is read in place
+	protocol_table_view<s_transmitter_raw_header> frame(this->recv_buffer, frame_len);
+	if (!frame.has_header()){
+		return false;
+	}
+	const s_transmitter_raw_header *header = frame.header();
+	if (header->channel_count <= TRANSMITTER_CHANNEL_STEER || !frame.valid(header->channel_count, frame_crc)){
+		return false;
+	}
+
+	for (int i = 0; i < header->channel_count; i++){
+		s_transmitter_channel_value value = { frame.entry(i)->in, frame.entry(i)->out };
+		this->received_channels.push_back(value);
+		this->received_raw.push_back(frame.entry(i)->raw);
+	}
+
+	//the values normalized by the transmitter stay the live state
+	this->ts_packet.in_throttle = frame.entry(TRANSMITTER_CHANNEL_THROTTLE)->in;
+	this->ts_packet.out_throttle = frame.entry(TRANSMITTER_CHANNEL_THROTTLE)->out;
+	this->ts_packet.in_steer = frame.entry(TRANSMITTER_CHANNEL_STEER)->in;
+	this->ts_packet.out_steer = frame.entry(TRANSMITTER_CHANNEL_STEER)->out;
+	this->ts_packet.in_button = header->in_button;
+	this->ts_packet.battery_voltage_mv = header->battery_voltage_mv;
+	this->ts_packet.CRC = frame.crc(header->channel_count);
+	sequence = header->sequence;
+	timestamp_us = header->timestamp_us;
+	return true;
+}
+
+void CommTransmitter::store_raw_channels(const string &transmitter_ip){
+	//queue_mutex has to be held by the caller
+	s_raw_channel_table &table(this->raw_channels);
+	for (size_t channel = 0; channel < this->received_raw.size(); channel++){
+		float raw = this->received_raw[channel];
+		map <pair<string, int>, size_t>::iterator row_iter = this->raw_channel_rows.find(make_pair(transmitter_ip, (int)channel));
+		if (row_iter != this->raw_channel_rows.end()){
+			table.raw[row_iter->second] = raw;
+			continue;
+		}
+		//new channel, the first value is taken as center (the sticks rest while a transmitter boots), the range grows from there
+		this->raw_channel_rows[make_pair(transmitter_ip, (int)channel)] = table.raw.size();
+		table.raw.push_back(raw);
+		table.min.push_back(raw);
+		table.center.push_back(raw);
+		table.max.push_back(raw);
+		table.auto_range.push_back(1);
+		table.normalized.push_back(0);
+	}
+	//frames without raw values leave the table as it is, no calibration pass for them
+	if (!this->received_raw.empty()){
+		this->raw_channels_dirty = true;
+	}
+}
+
+void CommTransmitter::calibrate_raw_channels(){
+	//queue_mutex has to be held by the caller
+	//every row of every transmitter in one pass, plain loops over the columns so the compiler vectorizes them
+	s_raw_channel_table &table(this->raw_channels);
+	size_t rows = table.raw.size();
+	const float *raw = table.raw.data();
+	const uint8_t *auto_range = table.auto_range.data();
+	const float *center = table.center.data();
+	float *min_in = table.min.data();
+	float *max_in = table.max.data();
+	float *normalized = table.normalized.data();
+
+	//continous calibration, as the firmware does it
+	for (size_t i = 0; i < rows; i++){
+		float grown_min = raw[i] < min_in[i] ? raw[i] : min_in[i];
+		float grown_max = raw[i] > max_in[i] ? raw[i] : max_in[i];
+		min_in[i] = auto_range[i] ? grown_min : min_in[i];
+		max_in[i] = auto_range[i] ? grown_max : max_in[i];
+	}
+
+	//three point linear interpolation, min -> -1, center -> 0, max -> 1
+	for (size_t i = 0; i < rows; i++){
+		float below = center[i] - min_in[i];
+		float above = max_in[i] - center[i];
+		below = below < RAW_CALIBRATION_MIN_RANGE ? RAW_CALIBRATION_MIN_RANGE : below;
+		above = above < RAW_CALIBRATION_MIN_RANGE ? RAW_CALIBRATION_MIN_RANGE : above;
+		float offset = raw[i] - center[i];
+		//one division with the range of the side, a division per side is not if-converted
+		float value = offset / (offset < 0 ? below : above);
+		value = value < -1.0f ? -1.0f : value;
+		value = value > 1.0f ? 1.0f : value;
+		normalized[i] = value;
+	}
+	this->raw_channels_dirty = false;
+}
+
+void CommTransmitter::append_state_history(Transmitter &transmitter){
+	//queue_mutex has to be held by the caller
+	for (size_t i = 0; i < this->received_samples.size(); i++){
+		transmitter.state_history.push_back(this->received_samples[i]);
+	}
+	while (transmitter.state_history.size() > STATE_HISTORY_SIZE){
+		transmitter.state_history.pop_front();
+	}
+}
+
+const int CommTransmitter::get_channels(string transmitter_ip, vector<s_transmitter_channel_value> &channels){
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		if (my_transmitter.alive){
+			channels = my_transmitter.channels;
+			queue_mutex.unlock();
+			return 0;
+		}
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+const int CommTransmitter::get_raw_channels(string transmitter_ip, vector<s_raw_channel> &channels){
+	queue_mutex.lock();
+	if (this->raw_channels_dirty){
+		this->calibrate_raw_channels();
+	}
+	const s_raw_channel_table &table(this->raw_channels);
+	channels.clear();
+	//rows are sorted by ipaddress and channel
+	map <pair<string, int>, size_t>::iterator row_iter = this->raw_channel_rows.lower_bound(make_pair(transmitter_ip, 0));
+	for (; row_iter != this->raw_channel_rows.end() && row_iter->first.first == transmitter_ip; row_iter++){
+		size_t row = row_iter->second;
+		s_raw_channel channel;
+		channel.channel = row_iter->first.second;
+		channel.raw = (uint16_t)table.raw[row];
+		channel.normalized = table.normalized[row];
+		channel.calibration.min = (uint16_t)table.min[row];
+		channel.calibration.center = (uint16_t)table.center[row];
+		channel.calibration.max = (uint16_t)table.max[row];
+		channel.calibration.auto_range = table.auto_range[row] != 0;
+		channels.push_back(channel);
+	}
+	queue_mutex.unlock();
+	//not found or no raw ADC live data...
+	return channels.empty() ? -1 : 0;
+}
+
+const int CommTransmitter::set_raw_calibration(string transmitter_ip, int channel, const s_raw_calibration &calibration){
+	if (calibration.min >= calibration.center || calibration.center >= calibration.max || calibration.max > RAW_ADC_MAX){
+		return -1;
+	}
+	queue_mutex.lock();
+	map <pair<string, int>, size_t>::iterator row_iter = this->raw_channel_rows.find(make_pair(transmitter_ip, channel));
+	if (row_iter != this->raw_channel_rows.end()){
+		size_t row = row_iter->second;
+		this->raw_channels.min[row] = calibration.min;
+		this->raw_channels.center[row] = calibration.center;
+		this->raw_channels.max[row] = calibration.max;
+		this->raw_channels.auto_range[row] = calibration.auto_range ? 1 : 0;
+		this->raw_channels_dirty = true;
+		queue_mutex.unlock();
+		return 0;
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+const int CommTransmitter::get_state_history(string transmitter_ip, vector<s_state_sample> &history){
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		history.assign(my_transmitter.state_history.begin(), my_transmitter.state_history.end());
+		queue_mutex.unlock();
+		return 0;
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+static int64_t server_time_us(chrono::steady_clock::time_point time_point){
+	return chrono::duration_cast<chrono::microseconds>(time_point.time_since_epoch()).count();
+}
+
+void CommTransmitter::send_clock_ping(Transmitter &transmitter){
+	//queue_mutex has to be held by the caller
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (now - transmitter.clock_last_ping < chrono::milliseconds(CLOCK_SYNC_INTERVAL_MS)){
+		return;
+	}
+	transmitter.clock_last_ping = now;
+
+	s_clock_ping ping;
+	memset(&ping, 0, sizeof(s_clock_ping));
+	ping.type = TRANSMITTER_FRAME_CLOCK_PING;
+	ping.server_tx_us = server_time_us(chrono::steady_clock::now());
+	protocol_seal(ping, frame_crc);
+	try{
+		this->sock->sendTo(&ping, sizeof(s_clock_ping), transmitter.ip_address, TRANSMITTER_PORT);
+	}
+	catch (const exception &ex){
+		cout << ex.what() << endl;
+	}
+}
+
+void CommTransmitter::send_telemetry_config(Transmitter &transmitter){
+	//queue_mutex has to be held by the caller
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	if (!transmitter.telemetry_configured || now - transmitter.telemetry_config_sent < chrono::milliseconds(TELEMETRY_CONFIG_RESEND_MS)){
+		return;
+	}
+	transmitter.telemetry_config_sent = now;
+	try{
+		this->sock->sendTo(&transmitter.telemetry_config, sizeof(s_telemetry_config), transmitter.ip_address, TRANSMITTER_PORT);
+	}
+	catch (const exception &ex){
+		cout << ex.what() << endl;
+	}
+}
+
+const int CommTransmitter::set_telemetry_config(string transmitter_ip, unsigned short packets_per_second, bool send_on_change, unsigned short heartbeat_ms, unsigned char deadband, bool raw_adc){
+	//switches the live data rate of a transmitter and optionally to send-on-change with heartbeat
+	//raw_adc: the transmitter sends its ADC values, see get_raw_channels()
+	if (packets_per_second < 1 || packets_per_second > 500){
+		return -1;
+	}
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		s_telemetry_config &config(my_transmitter.telemetry_config);
+		memset(&config, 0, sizeof(s_telemetry_config));
+		config.type = TRANSMITTER_FRAME_TELEMETRY_CONFIG;
+		config.mode = send_on_change ? TELEMETRY_MODE_ON_CHANGE : TELEMETRY_MODE_PERIODIC;
+		config.packets_per_second = packets_per_second;
+		config.heartbeat_ms = heartbeat_ms;
+		config.deadband = deadband;
+		config.flags = raw_adc ? TELEMETRY_FLAG_RAW_ADC : 0;
+		protocol_seal(config, frame_crc);
+		my_transmitter.telemetry_configured = true;
+		//send right away
+		my_transmitter.telemetry_config_sent = chrono::steady_clock::time_point();
+		this->send_telemetry_config(my_transmitter);
+		queue_mutex.unlock();
+		return 0;
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+int64_t CommTransmitter::unwrap_device_time(Transmitter &transmitter, uint32_t device_us){
+	//micros() of the transmitter wraps after ~71 minutes, continue counting in 64 bit
+	if (transmitter.clock_device_valid && (int32_t)(device_us - transmitter.clock_last_device_us) < -DEVICE_RESTART_BACKSTEP_US){
+		//gone back instead of wrapped, the transmitter rebooted
+		this->reset_clock(transmitter);
+	}
+	if (!transmitter.clock_device_valid){
+		transmitter.clock_device_valid = true;
+		transmitter.clock_device_us = device_us;
+	}
+	else{
+		transmitter.clock_device_us += (int32_t)(device_us - transmitter.clock_last_device_us);
+	}
+	transmitter.clock_last_device_us = device_us;
+	return transmitter.clock_device_us;
+}
+
+void CommTransmitter::reset_clock(Transmitter &transmitter){
+	//queue_mutex has to be held by the caller
+	//the transmitter rebooted, exchanges of before and after the reboot must not be fitted together
+	transmitter.clock_device_valid = false;
+	transmitter.clock_last_device_us = 0;
+	transmitter.clock_device_us = 0;
+	transmitter.clock_samples.clear();
+	transmitter.clock_valid = false;
+	//synchronize again right away
+	transmitter.clock_last_ping = chrono::steady_clock::time_point();
+}
+
+void CommTransmitter::receive_clock_pong(int frame_len, const string &source_address){
+	int64_t server_rx_us = server_time_us(chrono::steady_clock::now());
+	protocol_view<s_clock_pong> pong(this->recv_buffer, frame_len);
+	if (!pong.valid(frame_crc)){
+		return;
+	}
+
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(source_address) == this->connected_transmitters.end()){
+		queue_mutex.unlock();
+		return;
+	}
+	Transmitter &my_transmitter(this->connected_transmitters[source_address]);
+
+	//NTP style: t1 ping sent, t2 ping received, t3 pong sent, t4 pong received
+	int64_t t1 = (int64_t)pong->server_tx_us;
+	int64_t t2 = this->unwrap_device_time(my_transmitter, pong->device_rx_us);
+	int64_t t3 = t2 + (int32_t)(pong->device_tx_us - pong->device_rx_us);
+	int64_t t4 = server_rx_us;
+	this->unwrap_device_time(my_transmitter, pong->device_tx_us);
+
+	s_clock_sample my_sample;
+	my_sample.device_us = (t2 + t3) / 2;
+	my_sample.offset_us = ((t1 - t2) + (t4 - t3)) / 2.0;
+	my_sample.delay_us = (double)((t4 - t1) - (t3 - t2));
+	if (my_sample.delay_us >= 0){
+		my_transmitter.clock_samples.push_back(my_sample);
+		while (my_transmitter.clock_samples.size() > CLOCK_SYNC_SAMPLES){
+			my_transmitter.clock_samples.pop_front();
+		}
+		this->update_clock_estimate(my_transmitter);
+	}
+	queue_mutex.unlock();
+}
+
+void CommTransmitter::receive_diagnostics(int frame_len, const string &source_address){
+	protocol_view<s_transmitter_diagnostics> diagnostics(this->recv_buffer, frame_len);
+	if (!diagnostics.valid(frame_crc)){
+		return;
+	}
+
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(source_address) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[source_address]);
+		memcpy(&my_transmitter.diagnostics, diagnostics.frame(), sizeof(s_transmitter_diagnostics));
+		my_transmitter.diagnostics_valid = true;
+	}
+	queue_mutex.unlock();
+}
+
+void CommTransmitter::receive_blackbox_chunk(int frame_len, const string &source_address){
+	protocol_table_view<s_blackbox_chunk_header> frame(this->recv_buffer, frame_len);
+	if (!frame.has_header()){
+		return;
+	}
+	const s_blackbox_chunk_header *header = frame.header();
+	if (!frame.valid(header->entry_count, frame_crc)){
+		return;
+	}
+
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(source_address) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[source_address]);
+		//late answers to an earlier request are dropped
+		if (my_transmitter.blackbox_chunk == header->chunk && !my_transmitter.blackbox_chunk_received){
+			my_transmitter.blackbox_entries.assign(frame.entry(0), frame.entry(header->entry_count));
+			my_transmitter.blackbox_chunk_count = header->chunk_count;
+			my_transmitter.blackbox_dump_id = header->dump_id;
+			my_transmitter.blackbox_chunk_received = true;
+		}
+	}
+	queue_mutex.unlock();
+	this->blackbox_condition.notify_all();
+}
+
+void CommTransmitter::send_blackbox_request(const string &transmitter_ip, uint8_t flags, uint16_t chunk){
+	s_blackbox_request request;
+	memset(&request, 0, sizeof(s_blackbox_request));
+	request.type = TRANSMITTER_FRAME_BLACKBOX_REQUEST;
+	request.flags = flags;
+	request.chunk = chunk;
+	protocol_seal(request, frame_crc);
+	try{
+		this->sock->sendTo(&request, sizeof(s_blackbox_request), transmitter_ip, TRANSMITTER_PORT);
+	}
+	catch (const exception &ex){
+		cout << ex.what() << endl;
+	}
+}
+
+const int CommTransmitter::fetch_blackbox(string transmitter_ip, vector<s_blackbox_entry> &entries){
+	//blocks until the whole black box arrived, one chunk at a time - entries are ordered oldest first
+	//the transmitter does not record while it is fetched
+	unique_lock<mutex> lock(queue_mutex);
+	entries.clear();
+	uint16_t chunk = 0;
+	uint16_t chunk_count = 1; //known with the first chunk
+	uint32_t dump_id = 0;
+	bool failed = false;
+	while (chunk < chunk_count && !failed){
+		bool received = false;
+		for (int attempt = 0; attempt < BLACKBOX_REQUEST_ATTEMPTS && !received; attempt++){
+			if (this->connected_transmitters.find(transmitter_ip) == this->connected_transmitters.end()){
+				//not found or gone meanwhile...
+				return -1;
+			}
+			Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+			my_transmitter.blackbox_chunk = chunk;
+			my_transmitter.blackbox_chunk_received = false;
+			//the first chunk starts a new dump, also when it is asked for again
+			this->send_blackbox_request(transmitter_ip, chunk == 0 ? BLACKBOX_REQUEST_NEW : 0, chunk);
+			this->blackbox_condition.wait_for(lock, chrono::milliseconds(BLACKBOX_CHUNK_TIMEOUT_MS), [this, &transmitter_ip](){
+				return this->connected_transmitters.find(transmitter_ip) == this->connected_transmitters.end()
+					|| this->connected_transmitters[transmitter_ip].blackbox_chunk_received;
+			});
+			received = this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()
+				&& this->connected_transmitters[transmitter_ip].blackbox_chunk_received;
+		}
+		if (!received){
+			failed = true;
+			break;
+		}
+
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		if (chunk == 0){
+			chunk_count = my_transmitter.blackbox_chunk_count;
+			dump_id = my_transmitter.blackbox_dump_id;
+		}
+		else if (my_transmitter.blackbox_dump_id != dump_id){
+			//the transmitter gave up on the dump and started a new one
+			failed = true;
+			break;
+		}
+		entries.insert(entries.end(), my_transmitter.blackbox_entries.begin(), my_transmitter.blackbox_entries.end());
+		chunk++;
+	}
+
+	//done or given up, the transmitter records again
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		this->connected_transmitters[transmitter_ip].blackbox_chunk = -1;
+		this->send_blackbox_request(transmitter_ip, BLACKBOX_REQUEST_RELEASE, 0);
+	}
+	if (failed){
+		entries.clear();
+		return -1;
+	}
+	return 0;
+}
+
+void CommTransmitter::update_clock_estimate(Transmitter &transmitter){
+	//queue_mutex has to be held by the caller
+	//exchanges with a long round trip were delayed in one direction more than in the other, their offset is off
+	//so only the best CLOCK_SYNC_BEST_FRACTION are fitted, a line through them gives offset and drift
+	vector<s_clock_sample> best(transmitter.clock_samples.begin(), transmitter.clock_samples.end());
+	sort(best.begin(), best.end(), [](const s_clock_sample &a, const s_clock_sample &b){ return a.delay_us < b.delay_us; });
+	size_t used = (size_t)(best.size() * CLOCK_SYNC_BEST_FRACTION);
+	if (used < 1){
+		used = 1;
+	}
+	best.resize(used);
+
+	int64_t reference_us = transmitter.clock_samples.back().device_us;
+	double mean_x = 0, mean_y = 0;
+	for (size_t i = 0; i < used; i++){
+		mean_x += (double)(best[i].device_us - reference_us);
+		mean_y += best[i].offset_us;
+	}
+	mean_x /= used;
+	mean_y /= used;
+
+	double sxx = 0, sxy = 0;
+	for (size_t i = 0; i < used; i++){
+		double dx = (double)(best[i].device_us - reference_us) - mean_x;
+		sxx += dx * dx;
+		sxy += dx * (best[i].offset_us - mean_y);
+	}
+	double drift = (used > 1 && sxx > 0) ? sxy / sxx : 0;
+
+	double residual = 0;
+	for (size_t i = 0; i < used; i++){
+		double predicted = mean_y + drift * ((double)(best[i].device_us - reference_us) - mean_x);
+		residual += (best[i].offset_us - predicted) * (best[i].offset_us - predicted);
+	}
+	residual = sqrt(residual / used);
+
+	transmitter.clock_valid = true;
+	transmitter.clock_reference_us = reference_us;
+	transmitter.clock_offset_us = mean_y - drift * mean_x;
+	transmitter.clock_drift = drift;
+	transmitter.clock_min_delay_us = best[0].delay_us;
+	//the true offset is within half the round trip of the measured one
+	transmitter.clock_uncertainty_us = best[0].delay_us / 2.0 + residual;
+}
+
+const int CommTransmitter::to_server_time(string transmitter_ip, uint32_t device_timestamp_us, chrono::steady_clock::time_point &server_time){
+	//maps a micros() timestamp of the transmitter onto steady_clock of the server
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		if (my_transmitter.clock_valid){
+			int64_t device_us = my_transmitter.clock_device_us + (int32_t)(device_timestamp_us - my_transmitter.clock_last_device_us);
+			double since_reference_us = (double)(device_us - my_transmitter.clock_reference_us);
+			double server_us = (double)device_us + my_transmitter.clock_offset_us + my_transmitter.clock_drift * since_reference_us;
+			server_time = chrono::steady_clock::time_point(chrono::duration_cast<chrono::steady_clock::duration>(chrono::microseconds((int64_t)server_us)));
+			queue_mutex.unlock();
+			return 0;
+		}
+	}
+	//not found or not synchronized yet...
+	queue_mutex.unlock();
+	return -1;
+}
+
+const int CommTransmitter::get_clock_stats(string transmitter_ip, s_clock_stats &stats){
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		if (my_transmitter.clock_valid){
+			stats.offset_us = my_transmitter.clock_offset_us;
+			stats.drift_ppm = my_transmitter.clock_drift * 1e6;
+			stats.uncertainty_us = my_transmitter.clock_uncertainty_us;
+			stats.min_round_trip_us = my_transmitter.clock_min_delay_us;
+			stats.samples = (unsigned int)my_transmitter.clock_samples.size();
+			queue_mutex.unlock();
+			return 0;
+		}
+	}
+	//not found or not synchronized yet...
+	queue_mutex.unlock();
+	return -1;
+}
+
+static void to_loop_stats(const s_loop_diagnostics &window, s_loop_stats &stats){
+	stats.nominal_rate_hz = window.period_us > 0 ? 1e6 / window.period_us : 0;
+	stats.measured_rate_hz = window.window_us > 0 ? window.iterations * 1e6 / window.window_us : 0;
+	stats.max_jitter_us = 0;
+	if (window.iterations > 1){
+		//min_period_us is only set once a window saw two iterations
+		stats.max_jitter_us = max((double)window.max_period_us - window.period_us, (double)window.period_us - window.min_period_us);
+	}
+	stats.max_execution_us = window.max_execution_us;
+	stats.overruns = window.overruns;
+}
+
+const int CommTransmitter::get_loop_stats(string transmitter_ip, s_loop_stats &hal, s_loop_stats &comm){
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		if (my_transmitter.diagnostics_valid){
+			to_loop_stats(my_transmitter.diagnostics.hal, hal);
+			to_loop_stats(my_transmitter.diagnostics.comm, comm);
+			queue_mutex.unlock();
+			return 0;
+		}
+	}
+	//not found or the transmitter does not send diagnostics...
+	queue_mutex.unlock();
+	return -1;
+}
+
+const int CommTransmitter::get_link_stats(string transmitter_ip, s_link_stats &stats){
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		if (my_transmitter.sequence_valid){
+			stats.packets_received = my_transmitter.packets_received;
+			stats.packets_lost = my_transmitter.packets_lost;
+			stats.packets_reordered = my_transmitter.packets_reordered;
+			stats.packets_duplicate = my_transmitter.packets_duplicate;
+			stats.jitter_us = my_transmitter.jitter_us;
+			queue_mutex.unlock();
+			return 0;
+		}
+	}
+	//not found or no protocol v2 transmitter...
+	queue_mutex.unlock();
+	return -1;
+}
+
+void CommTransmitter::set_override_redundancy(bool enable, unsigned int max_copies, unsigned int gap_us){
+	queue_mutex.lock();
+	this->redundancy_enabled = enable;
+	this->redundancy_max_copies = max_copies < 1 ? 1 : max_copies;
+	this->redundancy_gap = chrono::microseconds(gap_us);
+	if (!enable){
+		this->redundant_send_queue.clear();
+	}
+	queue_mutex.unlock();
+}
+
+const int CommTransmitter::get_redundancy_stats(string transmitter_ip, s_redundancy_stats &stats){
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		Transmitter &my_transmitter(this->connected_transmitters[transmitter_ip]);
+		stats.telemetry_loss_rate = my_transmitter.loss_rate;
+		stats.copies = this->redundancy_enabled ? my_transmitter.redundancy : 1;
+		stats.redundant_sends = my_transmitter.redundant_sends;
+		queue_mutex.unlock();
+		return 0;
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+void CommTransmitter::set_override_pacing(bool enable, unsigned int interval_us){
+	queue_mutex.lock();
+	this->pacing_enabled = enable;
+	this->pacing_interval = chrono::microseconds(interval_us);
+	this->pacing_next_slot = chrono::steady_clock::now();
+	queue_mutex.unlock();
+	this->sender_condition.notify_one();
+}
+
+const int CommTransmitter::get_pacing_stats(s_pacing_stats &stats){
+	queue_mutex.lock();
+	stats.paced_sends = this->paced_sends;
+	stats.mean_queue_delay_us = this->paced_sends ? this->paced_queue_delay_sum_us / this->paced_sends : 0;
+	stats.max_queue_delay_us = this->paced_queue_delay_max_us;
+	queue_mutex.unlock();
+	return 0;
+}
+
+void CommTransmitter::run_sender(){
+	//paced override sending and redundant copies, the receive loop only sends overrides itself if pacing is disabled
+	unique_lock<mutex> lock(queue_mutex);
+
+	while (!this->sender_stop){
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		chrono::steady_clock::time_point next_wakeup = now + chrono::milliseconds(SENDER_IDLE_WAIT_MS);
+
+		//redundant copies which are due, they are complete packets already
+		while (!this->redundant_send_queue.empty() && this->redundant_send_queue.front().send_at <= now){
+			TransmitterOverride &my_copy(this->redundant_send_queue.front());
+			if (this->connected_transmitters.find(my_copy.ip_address) != this->connected_transmitters.end()){
+				this->send_control_packet(my_copy.ts_ct_packet, my_copy.ip_address);
+				this->connected_transmitters[my_copy.ip_address].redundant_sends++;
+			}
+			this->redundant_send_queue.pop_front();
+		}
+		if (!this->redundant_send_queue.empty() && this->redundant_send_queue.front().send_at < next_wakeup){
+			next_wakeup = this->redundant_send_queue.front().send_at;
+		}
+
+		if (this->pacing_enabled && !this->transmitter_override_queue.empty()){
+			if (now < this->pacing_next_slot){
+				//wait for our slot, pacing may be switched off meanwhile - so recheck everything afterwards
+				if (this->pacing_next_slot < next_wakeup){
+					next_wakeup = this->pacing_next_slot;
+				}
+			}
+			else{
+				//queue is FIFO with one override per transmitter (queue_override), so every transmitter waits one slot at most
+				TransmitterOverride &my_t_O(this->transmitter_override_queue.front());
+				//the queueing delay ends where the send starts
+				double queue_delay_us = chrono::duration<double, std::micro>(now - my_t_O.queued_at).count();
+				this->paced_sends++;
+				this->paced_queue_delay_sum_us += queue_delay_us;
+				if (queue_delay_us > this->paced_queue_delay_max_us){
+					this->paced_queue_delay_max_us = queue_delay_us;
+				}
+				if (this->connected_transmitters.find(my_t_O.ip_address) != this->connected_transmitters.end()){
+					this->send_override(my_t_O);
+				}
+				this->transmitter_override_queue.pop_front();
+
+				//every alive transmitter gets one slot within pacing_interval
+				unsigned int alive_transmitters = 0;
+				for (map <string, Transmitter>::iterator ct_iter = this->connected_transmitters.begin(); ct_iter != this->connected_transmitters.end(); ct_iter++){
+					if (ct_iter->second.alive){
+						alive_transmitters++;
+					}
+				}
+				if (alive_transmitters == 0){
+					alive_transmitters = 1;
+				}
+				this->pacing_next_slot = now + this->pacing_interval / alive_transmitters;
+				continue;
+			}
+		}
+
+		this->sender_condition.wait_until(lock, next_wakeup);
+	}
+}
+
+const int CommTransmitter::upload_trajectory(string transmitter_ip, const vector<s_trajectory_point> &points){
+	//replaces a previously uploaded trajectory, takes effect with the next start_trajectories()
+	queue_mutex.lock();
+	if (this->connected_transmitters.find(transmitter_ip) != this->connected_transmitters.end()){
+		if (this->connected_transmitters[transmitter_ip].alive){
+			this->trajectories[transmitter_ip] = points;
+			queue_mutex.unlock();
+			return 0;
+		}
+	}
+	//not found...
+	queue_mutex.unlock();
+	return -1;
+}
+
+void CommTransmitter::clear_trajectories(){
+	queue_mutex.lock();
+	this->trajectories.clear();
+	queue_mutex.unlock();
+}
+
+const int CommTransmitter::start_trajectories(unsigned int start_delay_us){
+	//all uploaded trajectories start at the same point in time, start_delay_us from now
+	this->stop_trajectories();
+
+	queue_mutex.lock();
+	if (this->trajectories.empty()){
+		queue_mutex.unlock();
+		return -1;
+	}
+
+	chrono::steady_clock::time_point start_time = chrono::steady_clock::now() + chrono::microseconds(start_delay_us);
+	vector<s_trajectory_event> events;
+	for (map <string, vector<s_trajectory_point> >::iterator tr_iter = this->trajectories.begin(); tr_iter != this->trajectories.end(); tr_iter++){
+		for (size_t i = 0; i < tr_iter->second.size(); i++){
+			s_trajectory_event my_event;
+			my_event.due = start_time + chrono::microseconds(tr_iter->second[i].time_us);
+			my_event.ip_address = tr_iter->first;
+			my_event.out_steer = tr_iter->second[i].out_steer;
+			my_event.out_throttle = tr_iter->second[i].out_throttle;
+			events.push_back(my_event);
+		}
+	}
+	//merge all cars into one timeline, stable to keep the point order of each car
+	stable_sort(events.begin(), events.end(), [](const s_trajectory_event &a, const s_trajectory_event &b){ return a.due < b.due; });
+
+	this->trajectory_send_error.clear();
+	this->trajectory_stop = false;
+	this->trajectory_playing = true;
+	this->trajectory_th = thread(&CommTransmitter::run_trajectory_player, this, events);
+	queue_mutex.unlock();
+	return 0;
+}
+
+void CommTransmitter::stop_trajectories(){
+	queue_mutex.lock();
+	this->trajectory_stop = true;
+	queue_mutex.unlock();
+	if (this->trajectory_th.joinable()){
+		this->trajectory_th.join();
+	}
+}
+
+bool CommTransmitter::trajectories_playing(){
+	queue_mutex.lock();
+	bool result = this->trajectory_playing;
+	queue_mutex.unlock();
+	return result;
+}
+
+LatencyHistogram CommTransmitter::get_trajectory_send_error(){
+	queue_mutex.lock();
+	LatencyHistogram result(this->trajectory_send_error);
+	queue_mutex.unlock();
+	return result;
+}
+
+bool CommTransmitter::wait_until_precise(int timer_fd, chrono::steady_clock::time_point due){
+	//sleeps until due, returns false if playback got stopped meanwhile
+	while (true){
+		queue_mutex.lock();
+		bool stopped = this->trajectory_stop;
+		queue_mutex.unlock();
+		if (stopped){
+			return false;
+		}
+
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		if (now >= due){
+			return true;
+		}
+		chrono::steady_clock::time_point wakeup = due;
+		if (due - now > chrono::microseconds(TRAJECTORY_WAIT_SLICE_US)){
+			wakeup = now + chrono::microseconds(TRAJECTORY_WAIT_SLICE_US);
+		}
+
+#ifdef __linux__
+		//steady_clock is CLOCK_MONOTONIC, so its time points can be used as absolute timer values
+		chrono::nanoseconds wakeup_ns = chrono::duration_cast<chrono::nanoseconds>(wakeup.time_since_epoch());
+		struct itimerspec timer_value;
+		memset(&timer_value, 0, sizeof(timer_value));
+		timer_value.it_value.tv_sec = (time_t)(wakeup_ns.count() / 1000000000);
+		timer_value.it_value.tv_nsec = (long)(wakeup_ns.count() % 1000000000);
+		if (timer_fd >= 0 && timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer_value, NULL) == 0){
+			uint64_t expirations;
+			if (read(timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations)){
+				continue;
+			}
+		}
+#endif
+		//no timerfd - sleep most of the time and spin the rest
+		if (wakeup - now > chrono::microseconds(TRAJECTORY_SPIN_US)){
+			this_thread::sleep_until(wakeup - chrono::microseconds(TRAJECTORY_SPIN_US));
+		}
+		while (chrono::steady_clock::now() < wakeup);
+	}
+}
+
+void CommTransmitter::run_trajectory_player(vector<s_trajectory_event> events){
+	int timer_fd = -1;
+#ifdef __linux__
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
+	if (timer_fd < 0){
+		cout << "timerfd not available, trajectory timing falls back to sleep" << endl;
+	}
+#endif
+
+	for (size_t i = 0; i < events.size(); i++){
+		if (!this->wait_until_precise(timer_fd, events[i].due)){
+			break;
+		}
+
+		queue_mutex.lock();
+		if (this->connected_transmitters.find(events[i].ip_address) != this->connected_transmitters.end()
+			&& this->connected_transmitters[events[i].ip_address].alive){
+			TransmitterOverride my_t_o;
+			my_t_o.port = TRANSMITTER_PORT;
+			my_t_o.override_throttle = true;
+			my_t_o.override_steer = true;
+			my_t_o.ip_address = events[i].ip_address;
+			my_t_o.ts_ct_packet.out_steer = events[i].out_steer;
+			my_t_o.ts_ct_packet.out_throttle = events[i].out_throttle;
+			my_t_o.queued_at = events[i].due;
+			this->send_override(my_t_o);
+			this->trajectory_send_error.add(chrono::duration<double, std::micro>(chrono::steady_clock::now() - events[i].due).count());
+		}
+		queue_mutex.unlock();
+	}
+
+#ifdef __linux__
+	if (timer_fd >= 0){
+		close(timer_fd);
+	}
+#endif
+	queue_mutex.lock();
+	this->trajectory_playing = false;
+	queue_mutex.unlock();
+}
+
+void CommTransmitter::set_group_address(string address, unsigned char multicast_ttl){
+	//the socket already has broadcast permission, multicast only needs a ttl
+	queue_mutex.lock();
+	this->group_address = address;
+	try{
+		this->sock->setMulticastTTL(multicast_ttl);
+	}
+	catch (const exception &ex){
+		cout << ex.what() << endl;
+	}
+	queue_mutex.unlock();
+}
+
+const int CommTransmitter::send_group_override(unsigned char group_id, const vector<s_group_override_entry> &entries){
+	//overrides many transmitters with a single datagram, returns the number of transmitters addressed
+	//built in place, the frame structs are packed
+	uint8_t frame[protocol_table_frame<s_group_override_header>::max_size];
+	s_group_override_header &header(*(s_group_override_header *)frame);
+	header.type = TRANSMITTER_FRAME_GROUP_OVERRIDE;
+	header.group_id = group_id;
+	header.slot_count = 0;
+	header.reserved = 0;
+
+	queue_mutex.lock();
+	for (size_t i = 0; i < entries.size(); i++){
+		if (this->connected_transmitters.find(entries[i].ip_address) == this->connected_transmitters.end()
+			|| !this->connected_transmitters[entries[i].ip_address].alive){
+			continue;
+		}
+		if (header.slot_count == GROUP_OVERRIDE_MAX_SLOTS){
+			queue_mutex.unlock();
+			return -1;
+		}
+		//transmitters identify their slot by the last octet of their ip address
+		s_group_override_slot &slot(*(s_group_override_slot *)(frame + protocol_table_frame<s_group_override_header>::crc_span(header.slot_count)));
+		size_t last_dot = entries[i].ip_address.rfind('.');
+		slot.transmitter_id = (uint8_t)atoi(entries[i].ip_address.c_str() + (last_dot == string::npos ? 0 : last_dot + 1));
+		slot.out_steer = entries[i].out_steer;
+		slot.out_throttle = entries[i].out_throttle;
+		header.slot_count++;
+	}
+	if (header.slot_count == 0){
+		queue_mutex.unlock();
+		return -1;
+	}
+
+	size_t frame_len = protocol_seal_table<s_group_override_header>(frame, header.slot_count, frame_crc);
+
+	try{
+		this->sock->sendTo(frame, (int)frame_len, this->group_address, TRANSMITTER_PORT);
+	}
+	catch (const exception &ex){
+		cout << ex.what() << endl;
+		queue_mutex.unlock();
+		return -1;
+	}
+	for (size_t i = 0; i < entries.size(); i++){
+		if (this->connected_transmitters.find(entries[i].ip_address) != this->connected_transmitters.end()
+			&& this->connected_transmitters[entries[i].ip_address].alive){
+			this->track_override_sent(this->connected_transmitters[entries[i].ip_address], entries[i].out_steer, entries[i].out_throttle);
+		}
+	}
+	queue_mutex.unlock();
+	return header.slot_count;
+}
+
 void CommTransmitter::run(){
 	chrono::system_clock::time_point  start = chrono::high_resolution_clock::now();
 	std::chrono::duration<double, std::nano> duration;
-	unsigned int count = 0;
-	unsigned int crc;
-	int recvMsgSize;                  // Size of received message
-	string source_address;             // Address of datagram source
-	unsigned short source_port;        // Port of datagram source
+	size_t batch_count;
 	this->stop = false;
 
 	while (!this->stop){
@@ -223,83 +1589,188 @@ void CommTransmitter::run(){
 		this->cleanup_transmitter_list();
 
 		duration = start - chrono::high_resolution_clock::now();
+		//wait for one datagram, then take what else is already waiting
+		batch_count = 0;
 		try{
-			recvMsgSize = this->sock->recvFrom(&this->ts_packet, sizeof(s_transmitter_state_packet), source_address, source_port);
+			do{
+				this->recv_batch_size[batch_count] = this->sock->recvFrom(this->recv_batch[batch_count], RECV_BUFFER_SIZE, this->recv_batch_address[batch_count], this->recv_batch_port[batch_count]);
+				batch_count++;
+			} while (batch_count < RECV_BATCH_MAX && this->sock->hasPendingDatagram());
 		}
 		catch (exception ex){
 			cout << ex.what() << endl;
-			continue;
 		}
-		crc = crc32_fast(&this->ts_packet, sizeof(s_transmitter_state_packet) - 4);
-		if (crc == this->ts_packet.CRC){
-			//cout << crc << ":" << this->ts_packet.CRC << endl;
-			queue_mutex.lock();
 
-			if (this->connected_transmitters.find(source_address) != this->connected_transmitters.end()){
-				//already enlisted, update
-				Transmitter &my_transmitter(this->connected_transmitters[source_address]);
+		//the CRCs of the v1/v2 state frames are checked up front, bit i is set for a valid one in slot i
+		uint64_t state_valid = this->verify_state_frames<s_transmitter_state_packet>(batch_count) | this->verify_state_frames<s_transmitter_state_packet_v2>(batch_count);
 
-				//set update time for cleanup
-				my_transmitter.last_packet_received = chrono::steady_clock::now();
+		for (size_t i = 0; i < batch_count; i++){
+			this->recv_buffer = this->recv_batch[i];
+			this->receive_datagram(this->recv_batch_size[i], this->recv_batch_address[i], this->recv_batch_port[i], ((state_valid >> i) & 1) != 0);
+		}
+	}
+}
 
-				//package is valid (crc checked) -> copy into live state
-				memcpy(&my_transmitter.ts_packet, &this->ts_packet, sizeof(s_transmitter_state_packet));
+//CRC check of the FRAME state frames among the batch, returns a bit per slot
+//enough of them are gathered into the SIMD lanes of crc32_verify_frames, a few are checked in place (crc32_fixed is quicker then)
+template <typename FRAME>
+uint64_t CommTransmitter::verify_state_frames(size_t batch_count){
+	size_t slots[RECV_BATCH_MAX];
+	size_t frame_count = 0;
+	uint64_t valid = 0;
+	for (size_t i = 0; i < batch_count; i++){
+		if (protocol_view<FRAME>(this->recv_batch[i], this->recv_batch_size[i]).matches()){
+			slots[frame_count++] = i;
+		}
+	}
+	if (frame_count < CRC32_VERIFY_MIN_FRAMES){
+		for (size_t n = 0; n < frame_count; n++){
+			if (protocol_view<FRAME>(this->recv_batch[slots[n]], this->recv_batch_size[slots[n]]).valid(frame_crc)){
+				valid |= (uint64_t)1 << slots[n];
+			}
+		}
+		return valid;
+	}
 
-				//in case this transmitter was sensed dead we set him back to alive
-				my_transmitter.alive = true;
-				//cout << my_transmitter.ip_address << ":" << (unsigned int)my_transmitter.ts_packet.in_steer << ":" << (unsigned int)my_transmitter.ts_packet.in_throttle << ":" << (unsigned int)my_transmitter.ts_packet.out_steer << ":" << (unsigned int)my_transmitter.ts_packet.out_throttle << endl;
+	for (size_t n = 0; n < frame_count; n++){
+		memcpy(this->recv_gather[n], this->recv_batch[slots[n]], protocol_frame<FRAME>::size);
+	}
+	uint64_t gathered_valid = crc32_verify_frames(this->recv_gather, RECV_GATHER_STRIDE, frame_count, protocol_frame<FRAME>::crc_span, frame_crc);
+	for (size_t n = 0; n < frame_count; n++){
+		valid |= ((gathered_valid >> n) & 1) << slots[n];
+	}
+	return valid;
+}
 
-			}
-			else{
-				//new transmitter showed up, add to list and create convinience pointer
-				Transmitter &my_transmitter(this->connected_transmitters[source_address]);
-				//set update time for cleanup
-				my_transmitter.last_packet_received = chrono::steady_clock::now();
+void CommTransmitter::receive_datagram(int recvMsgSize, const string &source_address, unsigned short source_port, bool state_crc_valid){
+	bool packet_valid = false;
+	bool has_sequence = false;
+	uint32_t sequence = 0;
+	uint32_t timestamp_us = 0;
+	this->received_samples.clear();
+	this->received_channels.clear();
+	this->received_raw.clear();
+	//frames are checked in place in recv_buffer, the CRC of a v1/v2 state frame already was (state_crc_valid)
+	protocol_view<s_transmitter_state_packet> packet_v1(this->recv_buffer, recvMsgSize);
+	protocol_view<s_transmitter_state_packet_v2> packet_v2(this->recv_buffer, recvMsgSize);
+	if (packet_v1.matches()){
+		//legacy v1 packet has no frame type, it is recognized by its size
+		packet_valid = state_crc_valid;
+		if (packet_valid){
+			memcpy(&this->ts_packet, packet_v1.frame(), sizeof(s_transmitter_state_packet));
+		}
+	}
+	else if (recvMsgSize > 0 && this->recv_buffer[0] == TRANSMITTER_FRAME_CLOCK_PONG){
+		this->receive_clock_pong(recvMsgSize, source_address);
+	}
+	else if (recvMsgSize > 0 && this->recv_buffer[0] == TRANSMITTER_FRAME_DIAGNOSTICS){
+		this->receive_diagnostics(recvMsgSize, source_address);
+	}
+	else if (recvMsgSize > 0 && this->recv_buffer[0] == TRANSMITTER_FRAME_BLACKBOX_CHUNK){
+		this->receive_blackbox_chunk(recvMsgSize, source_address);
+	}
+	else if (recvMsgSize > 0 && this->recv_buffer[0] == TRANSMITTER_FRAME_STATE_BATCH){
+		packet_valid = this->parse_state_batch(recvMsgSize, sequence, timestamp_us);
+		has_sequence = packet_valid;
+	}
+	else if (recvMsgSize > 0 && this->recv_buffer[0] == TRANSMITTER_FRAME_STATE_CHANNELS){
+		packet_valid = this->parse_state_channels(recvMsgSize, sequence, timestamp_us);
+		has_sequence = packet_valid;
+	}
+	else if (recvMsgSize > 0 && this->recv_buffer[0] == TRANSMITTER_FRAME_STATE_RAW){
+		packet_valid = this->parse_state_raw(recvMsgSize, sequence, timestamp_us);
+		has_sequence = packet_valid;
+	}
+	else if (packet_v2.matches() && state_crc_valid){
+		//same live data as v1, which stays the format of the live state
+		memcpy(&this->ts_packet, &packet_v2->state, sizeof(s_transmitter_state));
+		this->ts_packet.CRC = packet_v2->CRC;
+		has_sequence = true;
+		sequence = packet_v2->sequence;
+		timestamp_us = packet_v2->timestamp_us;
+		packet_valid = true;
+	}
 
-				//copy crc checked data into map
-				memcpy(&my_transmitter.ts_packet, &this->ts_packet, sizeof(s_transmitter_state_packet));
+	if (packet_valid && this->received_samples.empty()){
+		//single sample packet
+		s_state_sample my_sample;
+		my_sample.timestamp_us = timestamp_us;
+		my_sample.received = chrono::steady_clock::now();
+		copy_state(my_sample, *(const s_transmitter_state *)&this->ts_packet);
+		this->received_samples.push_back(my_sample);
+	}
 
-				//init map data from udp package
-				my_transmitter.ip_address = source_address;
-				my_transmitter.last_packet_received = chrono::steady_clock::now();
-				my_transmitter.monotonic_counter = this->monotonic_counter++;
-				my_transmitter.port = source_port;
-				//ITS ALIVE (HOHOHOHOHOHOHO)
-				my_transmitter.alive = true;
-				cout << "New Transmitter: " << my_transmitter.ip_address << endl;
-			}
+	if (packet_valid && this->received_channels.empty()){
+		//protocol v1/v2 carry throttle and steering only
+		s_transmitter_channel_value throttle = { this->ts_packet.in_throttle, this->ts_packet.out_throttle };
+		s_transmitter_channel_value steer = { this->ts_packet.in_steer, this->ts_packet.out_steer };
+		this->received_channels.push_back(throttle);
+		this->received_channels.push_back(steer);
+	}
 
-			if (!this->transmitter_override_queue.empty()){
-				//override queue has stuff to do...
-				TransmitterOverride &my_t_O(this->transmitter_override_queue.front());
-				
-				//check whether steering or throttle shall NOT be overridden - replace the unset value with the last read live value
-				if (my_t_O.override_steer == false){
-					//it is IN_STEER - NOT OUT_STEER - elsewise we would fix up the last sent value!!!
-					//in_steer is the value read from the ADC, out_steer would be the value we sent now and from there on to forever...
-					//if you don't understand this, ask. 
-					my_t_O.ts_ct_packet.out_steer = this->connected_transmitters[my_t_O.ip_address].ts_packet.in_steer;
-				}
-				//...
-				if (my_t_O.override_throttle == false){
-					//as above with steer, use tha transmitters IN value
-					//if you don't understand this, ask. 
-					my_t_O.ts_ct_packet.out_throttle = this->connected_transmitters[my_t_O.ip_address].ts_packet.in_throttle;
-				}
+	if (packet_valid){
+		//cout << crc << ":" << this->ts_packet.CRC << endl;
+		queue_mutex.lock();
 
-				my_t_O.ts_ct_packet.CRC = crc32_fast(&my_t_O.ts_ct_packet, sizeof(s_transmitter_control_packet) - 4);
-				
-				this->sock->sendTo(&my_t_O.ts_ct_packet, sizeof(s_transmitter_control_packet), my_t_O.ip_address, TRANSMITTER_PORT);
-				//cout << (unsigned short)my_t_O.ts_ct_packet.out_steer << ":" << (unsigned short)my_t_O.ts_ct_packet.out_throttle << "(" << my_t_O.ts_ct_packet.CRC << ")" << endl;
-				this->transmitter_override_queue.pop_front();
+		if (this->connected_transmitters.find(source_address) != this->connected_transmitters.end()){
+			//already enlisted, update
+			Transmitter &my_transmitter(this->connected_transmitters[source_address]);
 
+			//set update time for cleanup
+			my_transmitter.last_packet_received = chrono::steady_clock::now();
 
+			//package is valid (crc checked) -> copy into live state, unless it is an older one arriving late
+			//(late packets are not added to the history either, it stays in order)
+			if (!has_sequence || this->track_sequence(my_transmitter, sequence, timestamp_us)){
+				memcpy(&my_transmitter.ts_packet, &this->ts_packet, sizeof(s_transmitter_state_packet));
+				my_transmitter.channels = this->received_channels;
+				this->store_raw_channels(source_address);
+				this->append_state_history(my_transmitter);
 			}
 
-			queue_mutex.unlock();
-			cout << "Received packet from " << source_address << ":" << source_port << endl;
-			//cout << ts_packet.in_steer << " : " << ts_packet.in_throttle << " : " << ts_packet.out_steer << " : " << ts_packet.out_throttle << endl;
+			//in case this transmitter was sensed dead we set him back to alive
+			my_transmitter.alive = true;
+			//cout << my_transmitter.ip_address << ":" << (unsigned int)my_transmitter.ts_packet.in_steer << ":" << (unsigned int)my_transmitter.ts_packet.in_throttle << ":" << (unsigned int)my_transmitter.ts_packet.out_steer << ":" << (unsigned int)my_transmitter.ts_packet.out_throttle << endl;
+
 		}
+		else{
+			//new transmitter showed up, add to list and create convinience pointer
+			Transmitter &my_transmitter(this->connected_transmitters[source_address]);
+			//set update time for cleanup
+			my_transmitter.last_packet_received = chrono::steady_clock::now();
+
+			//copy crc checked data into map
+			memcpy(&my_transmitter.ts_packet, &this->ts_packet, sizeof(s_transmitter_state_packet));
+			my_transmitter.channels = this->received_channels;
+			this->store_raw_channels(source_address);
+			if (has_sequence){
+				this->track_sequence(my_transmitter, sequence, timestamp_us);
+			}
+			this->append_state_history(my_transmitter);
+
+			//init map data from udp package
+			my_transmitter.ip_address = source_address;
+			my_transmitter.last_packet_received = chrono::steady_clock::now();
+			my_transmitter.monotonic_counter = this->monotonic_counter++;
+			my_transmitter.port = source_port;
+			//ITS ALIVE (HOHOHOHOHOHOHO)
+			my_transmitter.alive = true;
+			cout << "New Transmitter: " << my_transmitter.ip_address << endl;
+		}
+
+		this->update_loss_estimate(this->connected_transmitters[source_address]);
+		this->track_override_applied(this->connected_transmitters[source_address]);
+		this->send_clock_ping(this->connected_transmitters[source_address]);
+		this->send_telemetry_config(this->connected_transmitters[source_address]);
+
+		if (!this->pacing_enabled && !this->transmitter_override_queue.empty()){
+			//override queue has stuff to do...
+			this->send_override(this->transmitter_override_queue.front());
+			this->transmitter_override_queue.pop_front();
+		}
+
+		queue_mutex.unlock();
+		cout << "Received packet from " << source_address << ":" << source_port << endl;
+		//cout << ts_packet.in_steer << " : " << ts_packet.in_throttle << " : " << ts_packet.out_steer << " : " << ts_packet.out_throttle << endl;
 	}
 }
-
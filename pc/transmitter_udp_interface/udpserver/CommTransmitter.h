@@ -1,41 +1,49 @@
 #pragma once
 #include <map>
 #include <list>
+#include <deque>
 #include <chrono>
 #include <inttypes.h>
 #include <thread>
+#include <condition_variable>
+#include <vector>
 
 #include "PracticalSocket.h" // For UDPSocket and SocketException
-
-#ifdef __GNUC__
-#define PACKED( class_to_pack ) class_to_pack __attribute__((__packed__))
-#else
-#define PACKED( class_to_pack ) __pragma( pack(push, 1) ) class_to_pack __pragma( pack(pop) )
-#endif
-
-
-
-//network packet sent from transmitter to server with live data
-PACKED(
-struct s_transmitter_state_packet{
+#include "LatencyHistogram.h"
+#include "transmitter_protocol.h" //frames shared with the transmitter firmware
+
+//receive buffer, large enough for every frame a transmitter sends
+#define RECV_BUFFER_SIZE	1500
+//datagrams taken from the socket in one go, their state frames are CRC checked together
+#define RECV_BATCH_MAX		32
+//slot size of the state frames gathered for the CRC lanes, a v2 frame rounded up to the 16 byte blocks the lanes read
+#define RECV_GATHER_STRIDE	32
+
+//number of live data samples kept per transmitter
+#define STATE_HISTORY_SIZE		2000
+
+//live data sample of a transmitter, batched frames carry several of them
+struct s_state_sample{
+	uint32_t timestamp_us; //micros() of the transmitter, 0 for v1 packets
+	chrono::steady_clock::time_point received;
 	uint8_t in_throttle;
 	uint8_t in_steer;
 	uint16_t in_button;
 	uint8_t out_throttle;
 	uint8_t out_steer;
 	uint16_t battery_voltage_mv;
-	uint32_t CRC;
 };
-);
 
-//network packet sent from server to transmitter with override data
-PACKED(
-struct s_transmitter_control_packet{
-	uint8_t out_throttle;
-	uint8_t out_steer;
-	uint32_t CRC;
+//resolution of the per transmitter override apply latency histogram
+#define APPLY_LATENCY_BUCKET_US		100
+#define APPLY_LATENCY_BUCKETS		1000
+
+//one ping/pong exchange, device_us is the unwrapped transmitter time in the middle of the exchange
+struct s_clock_sample{
+	int64_t device_us;
+	double offset_us; //server time - transmitter time
+	double delay_us; //round trip without the transmitter processing time
 };
-);
 
 
 class Transmitter{
@@ -44,8 +52,86 @@ public:
 	string ip_address;
 	unsigned int port;
 	s_transmitter_state_packet ts_packet;
-	chrono::system_clock::time_point last_packet_received;
+	//newest value of every analog channel, throttle and steering (from ts_packet) unless the transmitter sends protocol v3
+	vector<s_transmitter_channel_value> channels;
+	chrono::steady_clock::time_point last_packet_received;
 	bool alive;
+
+	//live data configuration, resent periodically as the transmitters do not acknowledge it
+	bool telemetry_configured;
+	s_telemetry_config telemetry_config;
+	chrono::steady_clock::time_point telemetry_config_sent;
+
+	//telemetry loss estimation, packets received within the current window compared to the nominal rate
+	unsigned int loss_window_packets;
+	chrono::steady_clock::time_point loss_window_start;
+	double loss_rate;
+
+	//sequence number of the next override, the transmitter drops overrides older than the last one it got
+	uint32_t control_sequence;
+
+	//redundant override transmission, every override is sent redundancy times
+	unsigned int redundancy;
+	unsigned long long redundant_sends;
+
+	//apply latency tracking, the latest override sent and the DAC values it will be echoed as
+	bool apply_pending;
+	chrono::steady_clock::time_point apply_sent_at;
+	uint8_t apply_expected_out_steer;
+	uint8_t apply_expected_out_throttle;
+	unsigned long long apply_timeouts;
+	LatencyHistogram apply_latency;
+
+	//protocol v2 sequence tracking, bit i of sequence_window is set if highest_sequence - i was received
+	bool sequence_valid;
+	uint32_t highest_sequence;
+	uint64_t sequence_window;
+	unsigned long long packets_received;
+	unsigned long long packets_lost;
+	unsigned long long packets_reordered;
+	unsigned long long packets_duplicate;
+	unsigned long long loss_window_lost_base;
+	unsigned long long loss_window_received_base;
+
+	//interarrival jitter as in RFC 3550, from the transmitter timestamps
+	chrono::steady_clock::time_point last_arrival;
+	uint32_t last_timestamp_us;
+	double jitter_us;
+
+	//live data history, oldest first
+	deque<s_state_sample> state_history;
+
+	//clock synchronization, server time = transmitter time + offset + drift * (transmitter time - reference)
+	chrono::steady_clock::time_point clock_last_ping;
+	bool clock_device_valid;
+	uint32_t clock_last_device_us; //for unwrapping the 32 bit micros() of the transmitter
+	int64_t clock_device_us; //unwrapped
+	deque<s_clock_sample> clock_samples;
+	bool clock_valid;
+	int64_t clock_reference_us;
+	double clock_offset_us;
+	double clock_drift;
+	double clock_uncertainty_us;
+	double clock_min_delay_us;
+
+	//newest loop timing reported by the transmitter (optional diagnostics frames)
+	bool diagnostics_valid;
+	s_transmitter_diagnostics diagnostics;
+
+	//black box chunk fetch_blackbox() waits for, stored by the receive thread
+	int blackbox_chunk; //-1 if none is waited for
+	bool blackbox_chunk_received;
+	uint16_t blackbox_chunk_count;
+	uint32_t blackbox_dump_id;
+	vector<s_blackbox_entry> blackbox_entries;
+
+	Transmitter() : telemetry_configured(false), loss_window_packets(0), loss_window_start(chrono::steady_clock::now()), loss_rate(0), control_sequence(0), redundancy(1), redundant_sends(0),
+		apply_pending(false), apply_timeouts(0), apply_latency(APPLY_LATENCY_BUCKET_US, APPLY_LATENCY_BUCKETS),
+		sequence_valid(false), highest_sequence(0), sequence_window(0), packets_received(0), packets_lost(0), packets_reordered(0), packets_duplicate(0),
+		loss_window_lost_base(0), loss_window_received_base(0), last_timestamp_us(0), jitter_us(0),
+		clock_device_valid(false), clock_last_device_us(0), clock_device_us(0), clock_valid(false), clock_reference_us(0),
+		clock_offset_us(0), clock_drift(0), clock_uncertainty_us(0), clock_min_delay_us(0), diagnostics_valid(false),
+		blackbox_chunk(-1), blackbox_chunk_received(false), blackbox_chunk_count(0), blackbox_dump_id(0) {};
 };
 
 
@@ -55,58 +141,298 @@ public:
 	unsigned int port;
 	bool override_steer;
 	bool override_throttle;
-	s_transmitter_control_packet ts_ct_packet;
+	s_transmitter_control_packet_v2 ts_ct_packet;
 	bool sent;
+	chrono::steady_clock::time_point queued_at; //for measuring the delay added by pacing
+	chrono::steady_clock::time_point send_at; //due time of a redundant copy
 
 	TransmitterOverride() : override_steer(false), override_throttle(false), sent(false) {};
 
 };
 
 
+//queueing delay added by the override pacing scheduler
+struct s_pacing_stats{
+	unsigned long long paced_sends;
+	double mean_queue_delay_us;
+	double max_queue_delay_us;
+};
+
+//redundant override transmission state of one transmitter
+struct s_redundancy_stats{
+	double telemetry_loss_rate;
+	unsigned int copies;
+	unsigned long long redundant_sends;
+};
+
+//one setpoint of an override trajectory, time_us is relative to the trajectory start
+struct s_trajectory_point{
+	unsigned int time_us;
+	uint8_t out_steer;
+	uint8_t out_throttle;
+};
+
+//trajectory point of one transmitter scheduled on the shared start time
+struct s_trajectory_event{
+	chrono::steady_clock::time_point due;
+	string ip_address;
+	uint8_t out_steer;
+	uint8_t out_throttle;
+};
+
+//override of one transmitter within a group override
+struct s_group_override_entry{
+	string ip_address;
+	uint8_t out_steer;
+	uint8_t out_throttle;
+};
+
+//link quality of a transmitter sending protocol v2 packets
+struct s_link_stats{
+	unsigned long long packets_received;
+	unsigned long long packets_lost;
+	unsigned long long packets_reordered;
+	unsigned long long packets_duplicate;
+	double jitter_us;
+};
+
+//estimated clock relation of a transmitter
+struct s_clock_stats{
+	double offset_us; //server time - transmitter time at the newest exchange
+	double drift_ppm;
+	double uncertainty_us;
+	double min_round_trip_us;
+	unsigned int samples;
+};
+
+//server side calibration of raw ADC live data (TELEMETRY_FLAG_RAW_ADC), per transmitter channel
+struct s_raw_calibration{
+	uint16_t min;
+	uint16_t center;
+	uint16_t max;
+	bool auto_range; //min and max follow the stick
+};
+
+struct s_raw_channel{
+	int channel;
+	uint16_t raw; //12 bit ADC after the input filter of the transmitter
+	float normalized; //-1 at min, 0 at center, 1 at max
+	s_raw_calibration calibration;
+};
+
+//raw channels of all transmitters, one row per transmitter channel and one array per column,
+//calibration and normalization of every car run as one pass over contiguous floats
+struct s_raw_channel_table{
+	vector<float> raw;
+	vector<float> min;
+	vector<float> center;
+	vector<float> max;
+	vector<uint8_t> auto_range;
+	vector<float> normalized;
+};
+
+//timing of one firmware task loop (HAL or comm) over the last reported window
+struct s_loop_stats{
+	double nominal_rate_hz;
+	double measured_rate_hz; //iterations within the window
+	double max_jitter_us; //largest deviation of a period from the nominal one
+	unsigned int max_execution_us; //worst case execution time
+	unsigned long overruns; //since boot of the transmitter
+};
+
+
 class CommTransmitter {
 private:
-	CommTransmitter::CommTransmitter();
+	CommTransmitter();
 
 	map <string, Transmitter> connected_transmitters; //ipaddress is key
 	list <TransmitterOverride> transmitter_override_queue;
 	s_transmitter_state_packet ts_packet;
+	uint8_t recv_batch[RECV_BATCH_MAX][RECV_BUFFER_SIZE];
+	int recv_batch_size[RECV_BATCH_MAX];
+	string recv_batch_address[RECV_BATCH_MAX];
+	unsigned short recv_batch_port[RECV_BATCH_MAX];
+	uint8_t *recv_buffer; //datagram of recv_batch currently processed
+	uint8_t recv_gather[RECV_BATCH_MAX][RECV_GATHER_STRIDE]; //state frames of one size out of recv_batch, for crc32_verify_frames
+	vector<s_state_sample> received_samples; //samples of the packet currently processed
+	vector<s_transmitter_channel_value> received_channels; //channels of the packet currently processed
+	vector<uint16_t> received_raw; //raw ADC values of the packet currently processed
+
+	//raw ADC live data, rows are kept when a transmitter goes away so its calibration survives a reconnect
+	s_raw_channel_table raw_channels;
+	map <pair<string, int>, size_t> raw_channel_rows; //(ipaddress, channel) is key
+	bool raw_channels_dirty; //raw values arrived since the last calibration pass
 	unsigned short listen_port;
 	bool running, stop;
 	UDPSocket *sock;
 	unsigned long monotonic_counter; //as stated, strictly monotonic for transmitter identification
+
+	//override pacing, spreads the sends of one controller tick over pacing_interval instead of bursting them
+	bool pacing_enabled;
+	chrono::microseconds pacing_interval;
+	chrono::steady_clock::time_point pacing_next_slot;
+	unsigned long long paced_sends;
+	double paced_queue_delay_sum_us;
+	double paced_queue_delay_max_us;
+	condition_variable sender_condition;
+	condition_variable blackbox_condition; //a black box chunk arrived
+	bool sender_stop;
+
+	//redundant override transmission, copies are sent by the sender thread once due
+	bool redundancy_enabled;
+	unsigned int redundancy_max_copies;
+	chrono::microseconds redundancy_gap;
+	list <TransmitterOverride> redundant_send_queue; //sorted by send_at
+
+	//uploaded override trajectories, played back by the trajectory thread
+	map <string, vector<s_trajectory_point> > trajectories; //ipaddress is key
+	bool trajectory_stop;
+	bool trajectory_playing;
+	LatencyHistogram trajectory_send_error; //deviation of the real send time from the scheduled one
+
+	//destination of group overrides, broadcast or multicast address
+	string group_address;
+
 	thread th;
+	thread sender_th;
+	thread trajectory_th;
+
+	void cleanup_transmitter_list();
+
+	void queue_override(const TransmitterOverride &t_o);
+
+	void send_override(TransmitterOverride &t_o);
+
+	void send_control_packet(s_transmitter_control_packet_v2 &packet, const string &transmitter_ip);
+
+	void schedule_redundant_copies(const TransmitterOverride &t_o);
+
+	void update_loss_estimate(Transmitter &transmitter);
 
-	void CommTransmitter::cleanup_transmitter_list();
+	void track_override_sent(Transmitter &transmitter, uint8_t out_steer, uint8_t out_throttle);
+
+	void track_override_applied(Transmitter &transmitter);
+
+	bool track_sequence(Transmitter &transmitter, uint32_t sequence, uint32_t timestamp_us);
+
+	bool parse_state_batch(int frame_len, uint32_t &sequence, uint32_t &timestamp_us);
+
+	bool parse_state_channels(int frame_len, uint32_t &sequence, uint32_t &timestamp_us);
+
+	bool parse_state_raw(int frame_len, uint32_t &sequence, uint32_t &timestamp_us);
+
+	void store_raw_channels(const string &transmitter_ip);
+
+	void calibrate_raw_channels();
+
+	void append_state_history(Transmitter &transmitter);
+
+	void send_clock_ping(Transmitter &transmitter);
+
+	void send_telemetry_config(Transmitter &transmitter);
+
+	void receive_clock_pong(int frame_len, const string &source_address);
+
+	void receive_diagnostics(int frame_len, const string &source_address);
+
+	void receive_blackbox_chunk(int frame_len, const string &source_address);
+
+	void send_blackbox_request(const string &transmitter_ip, uint8_t flags, uint16_t chunk);
+
+	int64_t unwrap_device_time(Transmitter &transmitter, uint32_t device_us);
+
+	void reset_clock(Transmitter &transmitter);
+
+	void update_clock_estimate(Transmitter &transmitter);
+
+	template <typename FRAME>
+	uint64_t verify_state_frames(size_t batch_count);
+
+	void receive_datagram(int recvMsgSize, const string &source_address, unsigned short source_port, bool state_crc_valid);
+
+	void run_sender();
+
+	void run_trajectory_player(vector<s_trajectory_event> events);
+
+	bool wait_until_precise(int timer_fd, chrono::steady_clock::time_point due);
 
 	static CommTransmitter* _pInstance;
 
 public:
 
-	CommTransmitter::CommTransmitter(const CommTransmitter&) = delete;
+	CommTransmitter(const CommTransmitter&) = delete;
 
 	static CommTransmitter& _getInstance();
 
 	static void _destroyInstance();
 
-	CommTransmitter::~CommTransmitter();
+	~CommTransmitter();
+
+	std::list<string> get_connected_transmitter_ips();
+
+	const int set_override_out_throttle(string transmitter_ip, unsigned short new_throttle);
+
+	const int set_override_out_steer(string transmitter_ip, unsigned short new_steer);
+
+	const int set_override_out_both(string transmitter_ip, unsigned short new_steer, unsigned short new_throttle);
+
+	const int get_out_throttle(string transmitter_ip);
+
+	const int get_out_steer(string transmitter_ip);
+
+	const int get_in_steer(string transmitter_ip);
+
+	const int get_in_throttle(string transmitter_ip);
+
+	void set_override_pacing(bool enable, unsigned int interval_us);
+
+	const int get_pacing_stats(s_pacing_stats &stats);
+
+	void set_override_redundancy(bool enable, unsigned int max_copies, unsigned int gap_us);
+
+	const int get_redundancy_stats(string transmitter_ip, s_redundancy_stats &stats);
+
+	const int upload_trajectory(string transmitter_ip, const vector<s_trajectory_point> &points);
+
+	void clear_trajectories();
+
+	const int start_trajectories(unsigned int start_delay_us);
+
+	void stop_trajectories();
+
+	bool trajectories_playing();
+
+	LatencyHistogram get_trajectory_send_error();
+
+	void set_group_address(string address, unsigned char multicast_ttl);
+
+	const int send_group_override(unsigned char group_id, const vector<s_group_override_entry> &entries);
+
+	const double get_apply_latency_percentile(string transmitter_ip, double percentile);
+
+	const int get_apply_latency_histogram(string transmitter_ip, LatencyHistogram &histogram);
+
+	const int get_link_stats(string transmitter_ip, s_link_stats &stats);
+
+	const int get_state_history(string transmitter_ip, vector<s_state_sample> &history);
 
-	std::list<string> CommTransmitter::get_connected_transmitter_ips();
+	const int get_channels(string transmitter_ip, vector<s_transmitter_channel_value> &channels);
 
-	const int CommTransmitter::set_override_out_throttle(string transmitter_ip, unsigned short new_throttle);
+	const int get_raw_channels(string transmitter_ip, vector<s_raw_channel> &channels);
 
-	const int CommTransmitter::set_override_out_steer(string transmitter_ip, unsigned short new_steer);
+	const int set_raw_calibration(string transmitter_ip, int channel, const s_raw_calibration &calibration);
 
-	const int CommTransmitter::set_override_out_both(string transmitter_ip, unsigned short new_steer, unsigned short new_throttle);
+	const int to_server_time(string transmitter_ip, uint32_t device_timestamp_us, chrono::steady_clock::time_point &server_time);
 
-	const int CommTransmitter::get_out_throttle(string transmitter_ip);
+	const int get_clock_stats(string transmitter_ip, s_clock_stats &stats);
 
-	const int CommTransmitter::get_out_steer(string transmitter_ip);
+	const int get_loop_stats(string transmitter_ip, s_loop_stats &hal, s_loop_stats &comm);
 
-	const int CommTransmitter::get_in_steer(string transmitter_ip);
+	const int fetch_blackbox(string transmitter_ip, vector<s_blackbox_entry> &entries);
 
-	const int CommTransmitter::get_in_throttle(string transmitter_ip);
+	const int set_telemetry_config(string transmitter_ip, unsigned short packets_per_second, bool send_on_change, unsigned short heartbeat_ms, unsigned char deadband, bool raw_adc);
 
-	void CommTransmitter::run();
+	void run();
 
 
 };
@@ -18,6 +18,8 @@
 
 
 #include "Crc32.h"
+// crc32_parallel
+#include "threadpool.h"
 
 // define endianess and some integer data types
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -43,6 +45,24 @@
 #endif
 
 
+#if defined(CRC32_USE_PCLMULQDQ) || defined(CRC32_USE_LANES)
+  // SSE2, SSSE3, AVX2 and PCLMULQDQ intrinsics, CPUID
+  #include <immintrin.h>
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    #define PCLMUL_TARGET
+    #define SSSE3_TARGET
+    #define AVX2_TARGET
+  #else
+    #include <cpuid.h>
+    // the kernels are compiled for their instruction set without enabling it for the rest of the file
+    #define PCLMUL_TARGET __attribute__((target("sse2,pclmul")))
+    #define SSSE3_TARGET  __attribute__((target("ssse3")))
+    #define AVX2_TARGET   __attribute__((target("avx2")))
+  #endif
+#endif
+
+
 /// zlib's CRC32 polynomial
 const uint32_t Polynomial = 0xEDB88320;
 
@@ -511,10 +531,145 @@ uint32_t crc32_16bytes_prefetch(const void* data, size_t length, uint32_t previo
 #endif
 
 
+#ifdef CRC32_USE_PCLMULQDQ
+/// shortest input crc32_fast hands to crc32_pclmul, it is ahead of the tables from its first 64 byte block
+/// (see arduino/host/crc32_bench.cpp)
+const size_t PclmulMinLength = 64;
+
+/// CPUID leaf 1: ECX bit 1 is PCLMULQDQ, EDX bit 26 is SSE2
+static bool detectPclmul()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 1)) != 0 && (info[3] & (1 << 26)) != 0;
+#else
+  unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+  return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & (1 << 1)) != 0 && (edx & (1 << 26)) != 0;
+#endif
+}
+
+/// true if the CPU supports crc32_pclmul
+bool crc32_pclmul_supported()
+{
+  static const bool supported = detectPclmul();
+  return supported;
+}
+
+
+/// fold 64 bytes at once with carry-less multiplications, then Barrett-reduce to 32 bits
+/// - based on Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+///   (the reflected variant, constants for Polynomial as in zlib/Chromium)
+/// - length must be a multiple of 16 and at least 64, crc is not inverted on entry or exit
+PCLMUL_TARGET
+static uint32_t crc32_pclmul_fold(const uint8_t* current, size_t length, uint32_t crc)
+{
+  // x^(4*128+32) mod P, x^(4*128-32) mod P (bit reflected, shifted by one)
+  const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+  // x^(128+32) mod P, x^(128-32) mod P
+  const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+  // x^64 mod P
+  const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124LL);
+  // P and mu = x^64 / P
+  const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+  const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+  __m128i x1 = _mm_loadu_si128((const __m128i*)(current + 0x00));
+  __m128i x2 = _mm_loadu_si128((const __m128i*)(current + 0x10));
+  __m128i x3 = _mm_loadu_si128((const __m128i*)(current + 0x20));
+  __m128i x4 = _mm_loadu_si128((const __m128i*)(current + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+  current += 64;
+  length  -= 64;
+
+  // four independent 128 bit accumulators, each folded 512 bits ahead
+  while (length >= 64)
+  {
+    __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+    __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+    __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+    __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)(current + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(current + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(current + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(current + 0x30)));
+    current += 64;
+    length  -= 64;
+  }
+
+  // fold the four accumulators into one
+  __m128i x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x2), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x3), x5);
+  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+  x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), x4), x5);
+
+  // remaining 16 byte blocks
+  while (length >= 16)
+  {
+    x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_loadu_si128((const __m128i*) current)), x5);
+    current += 16;
+    length  -= 16;
+  }
+
+  // 128 bits to 64 bits
+  x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+  x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, mask32);
+  x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1, k5k0, 0x00), x2);
+
+  // Barrett reduction to 32 bits
+  x2 = _mm_and_si128(x1, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+  x2 = _mm_and_si128(x2, mask32);
+  x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // bits 32..63
+  return (uint32_t) _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+
+/// compute CRC32 (PCLMULQDQ folding, 64 bytes at once), uses crc32_fast on CPUs without PCLMULQDQ
+uint32_t crc32_pclmul(const void* data, size_t length, uint32_t previousCrc32)
+{
+  const size_t BytesAtOnce = 64;
+  if (length < BytesAtOnce || !crc32_pclmul_supported())
+    return crc32_fast(data, length, previousCrc32);
+
+  size_t blocks = length & ~(size_t)15;
+  uint32_t crc = ~crc32_pclmul_fold((const uint8_t*) data, blocks, ~previousCrc32);
+  // remaining 0 to 15 bytes, crc32_fast stays on the lookup tables for them
+  return crc32_fast((const uint8_t*) data + blocks, length - blocks, crc);
+}
+#endif
+
+
 /// compute CRC32 using the fastest algorithm for large datasets on modern CPUs
 uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
 {
-#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
+#ifdef CRC32_USE_PCLMULQDQ
+  if (length >= PclmulMinLength && crc32_pclmul_supported())
+    return crc32_pclmul(data, length, previousCrc32);
+#endif
+
+#if defined(CRC32_USE_LOOKUP_TABLE_SLICING_BY_16) && defined(CRC32_USE_LOOKUP_TABLE_SLICING_BY_8)
+  // crc32_16bytes works on 64 byte blocks and does the rest byte by byte,
+  // Slicing-by-8 is up to twice as fast on that rest (see arduino/host/crc32_bench.cpp)
+  const size_t BytesAtOnce = 64;
+  if (length < BytesAtOnce)
+    return crc32_8bytes(data, length, previousCrc32);
+  size_t blocks = length & ~(BytesAtOnce - 1);
+  uint32_t crc = crc32_16bytes(data, blocks, previousCrc32);
+  return crc32_8bytes((const uint8_t*) data + blocks, length - blocks, crc);
+#elif defined(CRC32_USE_LOOKUP_TABLE_SLICING_BY_16)
   return crc32_16bytes (data, length, previousCrc32);
 #elif defined(CRC32_USE_LOOKUP_TABLE_SLICING_BY_8)
   return crc32_8bytes  (data, length, previousCrc32);
@@ -528,6 +683,297 @@ uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
 }
 
 
+/// multiply a and b modulo Polynomial (both bit reflected, x^0 is the highest bit)
+static uint32_t multiplyModulo(uint32_t a, uint32_t b)
+{
+  uint32_t product = 0;
+  for (uint32_t mask = 1u << 31; mask != 0; mask >>= 1)
+  {
+    if (a & mask)
+      product ^= b;
+    // b *= x
+    b = (b >> 1) ^ (-int32_t(b & 1) & Polynomial);
+  }
+  return product;
+}
+
+
+/// x^(2^n) modulo Polynomial for n = 0..31, each entry is the square of the one before
+/// (zlib's x2n_table, entry 0 is x^1)
+static const uint32_t PowerOfTwoPowers[32] =
+{
+  0x40000000,0x20000000,0x08000000,0x00800000,0x00008000,0xEDB88320,0xB1E6B092,0xA06A2517,
+  0xED627DAE,0x88D14467,0xD7BBFE6A,0xEC447F11,0x8E7EA170,0x6427800E,0x4D47BAE0,0x09FE548F,
+  0x83852D0F,0x30362F1A,0x7B5A9CC3,0x31FEC169,0x9FEC022A,0x6C8DEDC4,0x15D6874D,0x5FDE7A4E,
+  0xBAD90E37,0x2E4E5EEF,0x4EABA214,0xA8A472C0,0x429A969E,0x148D302A,0xC40BA6D0,0xC4E22C3C,
+};
+
+
+/// combine the CRC32 of two consecutive blocks A and B to the CRC32 of A followed by B
+uint32_t crc32_combine(uint32_t crcA, uint32_t crcB, size_t lengthB)
+{
+  // appending B shifts A by 8 * lengthB bits: crcA * x^(8 * lengthB), one factor per set bit of lengthB
+  // (the pre- and post-conditioning of both CRCs cancel out, as in zlib)
+  uint32_t shift = 0x80000000; // x^0
+  unsigned int power = 3; // lengthB bytes = lengthB * 2^3 bits
+  while (lengthB != 0)
+  {
+    if (lengthB & 1)
+      shift = multiplyModulo(PowerOfTwoPowers[power & 31], shift);
+    lengthB >>= 1;
+    power++;
+  }
+  return multiplyModulo(shift, crcA) ^ crcB;
+}
+
+
+#ifdef CRC32_USE_LANES
+/// longest frame the lanes check, the frame and its CRC are at most four 16 byte blocks
+const size_t LanesMaxLength = 60;
+/// below this number of frames checking them one by one is quicker than a (partly empty) step of 16 lanes
+const size_t LanesMinFrames = CRC32_VERIFY_MIN_FRAMES;
+
+/// the CRC is linear: crc32(frame) = crc32(as many zeros) ^ the contribution of each nibble of the frame alone,
+/// which only depends on the nibble and on how many bytes follow it
+/// [bytes following][low/high nibble][byte of the CRC][nibble], 7.5 KB, one PSHUFB table per nibble and CRC byte
+static uint8_t LaneNibbles[LanesMaxLength][2][4][16];
+
+static bool initLaneNibbles()
+{
+  for (size_t following = 0; following < LanesMaxLength; following++)
+    for (int high = 0; high < 2; high++)
+      for (uint32_t nibble = 0; nibble < 16; nibble++)
+      {
+        // this byte and the zeros behind it, without pre- and post-conditioning
+        uint32_t crc = high ? nibble << 4 : nibble;
+        for (size_t bit = 0; bit < 8 * (following + 1); bit++)
+          crc = (crc >> 1) ^ (-int32_t(crc & 1) & Polynomial);
+        for (int crcByte = 0; crcByte < 4; crcByte++)
+          LaneNibbles[following][high][crcByte][nibble] = (uint8_t)(crc >> (8 * crcByte));
+      }
+  return true;
+}
+
+enum LanesLevel { LanesNone, LanesSsse3, LanesAvx2 };
+
+/// CPUID leaf 1: ECX bit 9 is SSSE3, bit 27 OSXSAVE - leaf 7: EBX bit 5 is AVX2, XCR0 bits 1 and 2: the OS saves XMM/YMM
+static LanesLevel detectLanes()
+{
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info, 0);
+  int maxLeaf = info[0];
+  __cpuid(info, 1);
+  unsigned int ecx1 = info[2];
+  unsigned int ebx7 = 0;
+  if (maxLeaf >= 7)
+  {
+    __cpuidex(info, 7, 0);
+    ebx7 = info[1];
+  }
+  bool ymmSaved = (ecx1 & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6;
+#else
+  unsigned int eax = 0, ebx = 0, ecx1 = 0, edx = 0, ebx7 = 0;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx1, &edx))
+    return LanesNone;
+  if (__get_cpuid_max(0, 0) >= 7)
+    __cpuid_count(7, 0, eax, ebx7, ebx, edx);
+  bool ymmSaved = false;
+  if (ecx1 & (1 << 27))
+  {
+    unsigned int xcr0, xcr0High;
+    __asm__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0High) : "c" (0));
+    ymmSaved = (xcr0 & 6) == 6;
+  }
+#endif
+  if ((ebx7 & (1 << 5)) && ymmSaved)
+    return LanesAvx2;
+  if (ecx1 & (1 << 9))
+    return LanesSsse3;
+  return LanesNone;
+}
+
+/// transpose 16x16 bytes (per 128 bit half): afterwards row j holds byte j of all frames
+#define TRANSPOSE_ROUND(unpacklo, unpackhi, in, out) \
+  out[ 0] = unpacklo(in[0], in[ 8]); out[ 1] = unpackhi(in[0], in[ 8]); \
+  out[ 2] = unpacklo(in[1], in[ 9]); out[ 3] = unpackhi(in[1], in[ 9]); \
+  out[ 4] = unpacklo(in[2], in[10]); out[ 5] = unpackhi(in[2], in[10]); \
+  out[ 6] = unpacklo(in[3], in[11]); out[ 7] = unpackhi(in[3], in[11]); \
+  out[ 8] = unpacklo(in[4], in[12]); out[ 9] = unpackhi(in[4], in[12]); \
+  out[10] = unpacklo(in[5], in[13]); out[11] = unpackhi(in[5], in[13]); \
+  out[12] = unpacklo(in[6], in[14]); out[13] = unpackhi(in[6], in[14]); \
+  out[14] = unpacklo(in[7], in[15]); out[15] = unpackhi(in[7], in[15]);
+#define TRANSPOSE(unpacklo, unpackhi, rows, scratch) \
+  TRANSPOSE_ROUND(unpacklo, unpackhi, rows, scratch) \
+  TRANSPOSE_ROUND(unpacklo, unpackhi, scratch, rows) \
+  TRANSPOSE_ROUND(unpacklo, unpackhi, rows, scratch) \
+  TRANSPOSE_ROUND(unpacklo, unpackhi, scratch, rows)
+
+/// check up to 16 frames, one per byte lane of a SSE register, missing frames repeat the first one and are masked out
+SSSE3_TARGET
+static uint32_t verifyLanes16(const uint8_t* frames, size_t stride, size_t count, size_t length, uint32_t zerosCrc)
+{
+  // bytes of the frames in columns: columns[i] holds byte i of all 16 frames
+  __m128i columns[LanesMaxLength + 4];
+  const size_t blocks = (length + 4 + 15) / 16;
+  for (size_t block = 0; block < blocks; block++)
+  {
+    __m128i* rows = columns + 16 * block;
+    __m128i scratch[16];
+    for (size_t frame = 0; frame < 16; frame++)
+      rows[frame] = _mm_loadu_si128((const __m128i*)(frames + (frame < count ? frame : 0) * stride + 16 * block));
+    TRANSPOSE(_mm_unpacklo_epi8, _mm_unpackhi_epi8, rows, scratch)
+  }
+
+  const __m128i lowNibble = _mm_set1_epi8(0x0F);
+  __m128i crc0 = _mm_set1_epi8((char) zerosCrc);
+  __m128i crc1 = _mm_set1_epi8((char)(zerosCrc >>  8));
+  __m128i crc2 = _mm_set1_epi8((char)(zerosCrc >> 16));
+  __m128i crc3 = _mm_set1_epi8((char)(zerosCrc >> 24));
+  for (size_t i = 0; i < length; i++)
+  {
+    const uint8_t (*nibbles)[4][16] = LaneNibbles[length - 1 - i];
+    __m128i low  = _mm_and_si128(columns[i], lowNibble);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(columns[i], 4), lowNibble);
+    crc0 = _mm_xor_si128(crc0, _mm_xor_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[0][0]), low),
+                                             _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[1][0]), high)));
+    crc1 = _mm_xor_si128(crc1, _mm_xor_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[0][1]), low),
+                                             _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[1][1]), high)));
+    crc2 = _mm_xor_si128(crc2, _mm_xor_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[0][2]), low),
+                                             _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[1][2]), high)));
+    crc3 = _mm_xor_si128(crc3, _mm_xor_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[0][3]), low),
+                                             _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) nibbles[1][3]), high)));
+  }
+
+  // the stored CRCs are the next four columns
+  __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(crc0, columns[length    ]), _mm_cmpeq_epi8(crc1, columns[length + 1])),
+                                _mm_and_si128(_mm_cmpeq_epi8(crc2, columns[length + 2]), _mm_cmpeq_epi8(crc3, columns[length + 3])));
+  return (uint32_t) _mm_movemask_epi8(match) & ((1u << count) - 1);
+}
+
+/// check 32 frames, one per byte lane of an AVX2 register (frames 0..15 in the lower half, 16..31 in the upper)
+AVX2_TARGET
+static uint32_t verifyLanes32(const uint8_t* frames, size_t stride, size_t length, uint32_t zerosCrc)
+{
+  __m256i columns[LanesMaxLength + 4];
+  const size_t blocks = (length + 4 + 15) / 16;
+  for (size_t block = 0; block < blocks; block++)
+  {
+    __m256i* rows = columns + 16 * block;
+    __m256i scratch[16];
+    for (size_t frame = 0; frame < 16; frame++)
+    {
+      __m128i lower = _mm_loadu_si128((const __m128i*)(frames +  frame       * stride + 16 * block));
+      __m128i upper = _mm_loadu_si128((const __m128i*)(frames + (frame + 16) * stride + 16 * block));
+      rows[frame] = _mm256_inserti128_si256(_mm256_castsi128_si256(lower), upper, 1);
+    }
+    TRANSPOSE(_mm256_unpacklo_epi8, _mm256_unpackhi_epi8, rows, scratch)
+  }
+
+  const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+  __m256i crc0 = _mm256_set1_epi8((char) zerosCrc);
+  __m256i crc1 = _mm256_set1_epi8((char)(zerosCrc >>  8));
+  __m256i crc2 = _mm256_set1_epi8((char)(zerosCrc >> 16));
+  __m256i crc3 = _mm256_set1_epi8((char)(zerosCrc >> 24));
+  for (size_t i = 0; i < length; i++)
+  {
+    const uint8_t (*nibbles)[4][16] = LaneNibbles[length - 1 - i];
+    __m256i low  = _mm256_and_si256(columns[i], lowNibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(columns[i], 4), lowNibble);
+    // PSHUFB works within each 128 bit half, both halves get the same table
+    crc0 = _mm256_xor_si256(crc0, _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[0][0])), low),
+                                                   _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[1][0])), high)));
+    crc1 = _mm256_xor_si256(crc1, _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[0][1])), low),
+                                                   _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[1][1])), high)));
+    crc2 = _mm256_xor_si256(crc2, _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[0][2])), low),
+                                                   _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[1][2])), high)));
+    crc3 = _mm256_xor_si256(crc3, _mm256_xor_si256(_mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[0][3])), low),
+                                                   _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*) nibbles[1][3])), high)));
+  }
+
+  __m256i match = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi8(crc0, columns[length    ]), _mm256_cmpeq_epi8(crc1, columns[length + 1])),
+                                   _mm256_and_si256(_mm256_cmpeq_epi8(crc2, columns[length + 2]), _mm256_cmpeq_epi8(crc3, columns[length + 3])));
+  return (uint32_t) _mm256_movemask_epi8(match);
+}
+#endif
+
+
+/// check up to CRC32_VERIFY_MAX_FRAMES frames of the same length
+uint64_t crc32_verify_frames(const void* frames, size_t stride, size_t count, size_t length, Crc32Frame frameCrc)
+{
+  const uint8_t* current = (const uint8_t*) frames;
+  uint64_t valid = 0;
+  size_t frame = 0;
+  if (count > CRC32_VERIFY_MAX_FRAMES)
+    count = CRC32_VERIFY_MAX_FRAMES;
+
+#ifdef CRC32_USE_LANES
+  static const LanesLevel level = detectLanes();
+  if (level != LanesNone && length <= LanesMaxLength && count >= LanesMinFrames)
+  {
+    static const bool initialized = initLaneNibbles();
+    (void) initialized;
+    static const uint8_t Zeros[LanesMaxLength] = { 0 };
+    uint32_t zerosCrc = crc32_fast(Zeros, length);
+
+    if (level == LanesAvx2)
+      for (; frame + 32 <= count; frame += 32)
+        valid |= (uint64_t) verifyLanes32(current + frame * stride, stride, length, zerosCrc) << frame;
+    // the last step may be partly empty
+    for (; frame + LanesMinFrames <= count; frame += 16)
+    {
+      size_t lanes = count - frame < 16 ? count - frame : 16;
+      valid |= (uint64_t) verifyLanes16(current + frame * stride, stride, lanes, length, zerosCrc) << frame;
+    }
+  }
+#endif
+
+  // the rest one by one
+  for (; frame < count; frame++)
+  {
+    const uint8_t* data = current + frame * stride;
+    uint32_t expected = uint32_t(data[length]) | uint32_t(data[length + 1]) << 8 | uint32_t(data[length + 2]) << 16 | uint32_t(data[length + 3]) << 24;
+    uint32_t crc = frameCrc != NULL ? frameCrc(data, length) : crc32_fast(data, length);
+    if (crc == expected)
+      valid |= (uint64_t) 1 << frame;
+  }
+  return valid;
+}
+
+
+/// below this part size the threads cost more than they save
+const size_t ParallelMinPart = 1024 * 1024;
+
+/// compute CRC32 of a large dataset in parallel
+uint32_t crc32_parallel(const void* data, size_t length, ThreadPool& pool, uint32_t previousCrc32)
+{
+  size_t parts = pool.size() + 1;
+  if (length / parts < ParallelMinPart)
+    parts = length / ParallelMinPart;
+  if (parts <= 1)
+    return crc32_fast(data, length, previousCrc32);
+
+  // full 64 byte blocks for each part but the last, it takes the rest
+  const uint8_t* current = (const uint8_t*) data;
+  const size_t partLength = (length / parts) & ~(size_t)63;
+  const size_t lastLength = length - (parts - 1) * partLength;
+
+  std::vector< std::future<uint32_t> > results;
+  for (size_t part = 1; part < parts; part++)
+  {
+    const uint8_t* partData = current + part * partLength;
+    size_t partSize = part == parts - 1 ? lastLength : partLength;
+    results.push_back(pool.enqueue([partData, partSize]() { return crc32_fast(partData, partSize); }));
+  }
+
+  // the first part on this thread, while the pool works on the others
+  uint32_t crc = crc32_fast(current, partLength, previousCrc32);
+  for (size_t part = 1; part < parts; part++)
+    crc = crc32_combine(crc, results[part - 1].get(), part == parts - 1 ? lastLength : partLength);
+  return crc;
+}
+
+
 // //////////////////////////////////////////////////////////
 // constants
 
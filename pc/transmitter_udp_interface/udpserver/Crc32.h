@@ -6,6 +6,8 @@
 // see http://create.stephan-brumme.com/disclaimer.html
 //
 
+#pragma once
+
 // if running on an embedded system, you might consider shrinking the
 // big Crc32Lookup table by undefining these lines:
 #define CRC32_USE_LOOKUP_TABLE_BYTE
@@ -22,6 +24,14 @@
 // - crc32_16bytes  needs all of Crc32Lookup
 // using the aforementioned #defines the the table is automatically fitted to your needs
 
+// x86 CPUs with carry-less multiplication (PCLMULQDQ) fold large datasets much faster than
+// any lookup table, and with SSSE3/AVX2 they check many short frames at once (one frame per byte lane),
+// whether the CPU has it is checked at runtime
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CRC32_USE_PCLMULQDQ
+#define CRC32_USE_LANES
+#endif
+
 // uint8_t, uint32_t, int32_t
 #include <stdint.h>
 // size_t
@@ -64,3 +74,107 @@ uint32_t crc32_16bytes (const void* data, size_t length, uint32_t previousCrc32
 /// compute CRC32 (Slicing-by-16 algorithm, prefetch upcoming data blocks)
 uint32_t crc32_16bytes_prefetch(const void* data, size_t length, uint32_t previousCrc32 = 0, size_t prefetchAhead = 256);
 #endif
+
+/// combine the CRC32 of two consecutive blocks A and B to the CRC32 of A followed by B
+/// - crcB has to be computed with previousCrc32 = 0, lengthB is the size of B in bytes
+uint32_t crc32_combine(uint32_t crcA, uint32_t crcB, size_t lengthB);
+
+/// see threadpool.h
+class ThreadPool;
+/// compute CRC32 of a large dataset in parallel: one part per thread of pool and one on the calling thread,
+/// merged by crc32_combine - must not be called from a task of the same pool
+uint32_t crc32_parallel(const void* data, size_t length, ThreadPool& pool, uint32_t previousCrc32 = 0);
+
+/// most frames crc32_verify_frames checks in one call
+#define CRC32_VERIFY_MAX_FRAMES 64
+/// fewer frames do not fill enough lanes, crc32_verify_frames checks them one by one
+#define CRC32_VERIFY_MIN_FRAMES 12
+/// CRC32 of a single frame, e.g. a switch over the frame lengths to crc32_fixed
+typedef uint32_t (*Crc32Frame)(const void* data, size_t length);
+/// check up to CRC32_VERIFY_MAX_FRAMES frames of the same length, frame i starts at frames + i * stride:
+/// the CRC32 of its first length bytes has to match the little endian uint32_t right behind them
+/// - returns a bitmap, bit i is set if frame i is valid
+/// - with SSSE3 (16 frames) or AVX2 (32 frames) one frame per byte lane
+/// - frames left over by the lanes (all of them without lanes) are checked one by one with frameCrc, crc32_fast if NULL
+/// - the lanes read whole 16 byte blocks, each frame needs (length + 4 + 15) & ~15 readable bytes
+uint64_t crc32_verify_frames(const void* frames, size_t stride, size_t count, size_t length, Crc32Frame frameCrc = NULL);
+
+#ifdef CRC32_USE_PCLMULQDQ
+/// compute CRC32 (PCLMULQDQ folding, 64 bytes at once), uses crc32_fast on CPUs without PCLMULQDQ
+uint32_t crc32_pclmul  (const void* data, size_t length, uint32_t previousCrc32 = 0);
+/// true if the CPU supports crc32_pclmul
+bool crc32_pclmul_supported();
+#endif
+
+
+// //////////////////////////////////////////////////////////
+// fixed length CRC32 for the tiny protocol frames
+
+/// compile-time generated tables and the unrolled steps of crc32_fixed
+namespace crc32_fixed_detail
+{
+  /// one byte of crc32_bitwise, evaluated by the compiler
+  constexpr uint32_t bitwise(uint32_t crc, int bits)
+  {
+    return bits == 0 ? crc : bitwise((crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1, bits - 1);
+  }
+
+  /// entry of Crc32Lookup[slice]: the byte shifted through slice more zero bytes
+  constexpr uint32_t slice(uint32_t index, int slice)
+  {
+    return bitwise(index, 8 * (slice + 1));
+  }
+
+  /// same content as Crc32Lookup[0..3], but only 4 KB and built at compile time
+  template<uint32_t... Index> struct table
+  {
+    static constexpr uint32_t values[4][sizeof...(Index)] =
+    {
+      { slice(Index, 0)... }, { slice(Index, 1)... }, { slice(Index, 2)... }, { slice(Index, 3)... }
+    };
+  };
+  template<uint32_t... Index> constexpr uint32_t table<Index...>::values[4][sizeof...(Index)];
+
+  /// expands to table<0, 1, ..., 255>
+  template<uint32_t Count, uint32_t... Index> struct make_table : make_table<Count - 1, Count - 1, Index...> {};
+  template<uint32_t... Index> struct make_table<0, Index...> { typedef table<Index...> type; };
+
+  typedef make_table<256>::type lookup;
+  static_assert(lookup::values[0][1] == 0x77073096 && lookup::values[0][255] == 0x2D02EF8D
+             && lookup::values[3][1] == 0xB8BC6765 && lookup::values[3][255] == 0xDE0506F1, "crc32_fixed: tables do not match Crc32Lookup");
+
+  /// N bytes without a loop counter, four at a time (Slicing-by-4), the rest bytewise
+  template<size_t N, bool Slice = (N >= 4)> struct unrolled
+  {
+    static inline uint32_t update(uint32_t crc, const uint8_t* current)
+    {
+      // assembled bytewise, independent of the endianess (compilers turn it into a single load)
+      uint32_t one = crc ^ (uint32_t(current[0]) | uint32_t(current[1]) << 8 | uint32_t(current[2]) << 16 | uint32_t(current[3]) << 24);
+      crc = lookup::values[0][ one >> 24        ] ^
+            lookup::values[1][(one >> 16) & 0xFF] ^
+            lookup::values[2][(one >>  8) & 0xFF] ^
+            lookup::values[3][ one        & 0xFF];
+      return unrolled<N - 4>::update(crc, current + 4);
+    }
+  };
+  template<size_t N> struct unrolled<N, false>
+  {
+    static inline uint32_t update(uint32_t crc, const uint8_t* current)
+    {
+      crc = (crc >> 8) ^ lookup::values[0][(crc & 0xFF) ^ *current];
+      return unrolled<N - 1>::update(crc, current + 1);
+    }
+  };
+  template<> struct unrolled<0, false>
+  {
+    static inline uint32_t update(uint32_t crc, const uint8_t*) { return crc; }
+  };
+}
+
+/// compute CRC32 of exactly N bytes (fully unrolled Slicing-by-4, 4 KB compile-time tables)
+/// - meant for the fixed size protocol frames, same result as crc32_bitwise
+template<size_t N>
+inline uint32_t crc32_fixed(const void* data, uint32_t previousCrc32 = 0)
+{
+  return ~crc32_fixed_detail::unrolled<N>::update(~previousCrc32, (const uint8_t*) data);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <vector>
+
+using namespace std;
+
+//latency histogram with fixed bucket width, values beyond the last bucket end up in an overflow bucket
+//percentiles are resolved to the upper edge of the bucket they fall in
+class LatencyHistogram{
+public:
+	LatencyHistogram(double bucket_width_us = 10, unsigned int bucket_count = 1000) :
+		bucket_width_us(bucket_width_us),
+		buckets(bucket_count + 1, 0),
+		samples(0),
+		sum_us(0),
+		min_us(0),
+		max_us(0){
+	};
+
+	void add(double value_us){
+		if (value_us < 0){
+			value_us = 0;
+		}
+		size_t bucket = (size_t)(value_us / this->bucket_width_us);
+		if (bucket >= this->buckets.size() - 1){
+			//overflow
+			bucket = this->buckets.size() - 1;
+		}
+		this->buckets[bucket]++;
+
+		if (this->samples == 0 || value_us < this->min_us){
+			this->min_us = value_us;
+		}
+		if (value_us > this->max_us){
+			this->max_us = value_us;
+		}
+		this->sum_us += value_us;
+		this->samples++;
+	};
+
+	void clear(){
+		for (size_t i = 0; i < this->buckets.size(); i++){
+			this->buckets[i] = 0;
+		}
+		this->samples = 0;
+		this->sum_us = 0;
+		this->min_us = 0;
+		this->max_us = 0;
+	};
+
+	//percentile in [0, 100], returns -1 if there are no samples
+	double percentile(double percent) const{
+		if (this->samples == 0){
+			return -1;
+		}
+		unsigned long long rank = (unsigned long long)(percent / 100.0 * this->samples + 0.5);
+		if (rank < 1){
+			rank = 1;
+		}
+		unsigned long long seen = 0;
+		for (size_t i = 0; i < this->buckets.size() - 1; i++){
+			seen += this->buckets[i];
+			if (seen >= rank){
+				double upper_edge = (i + 1) * this->bucket_width_us;
+				return upper_edge < this->max_us ? upper_edge : this->max_us;
+			}
+		}
+		//rank is in the overflow bucket, the maximum is the best we know
+		return this->max_us;
+	};
+
+	unsigned long long get_count() const { return this->samples; };
+	double get_mean_us() const { return this->samples ? this->sum_us / this->samples : 0; };
+	double get_min_us() const { return this->min_us; };
+	double get_max_us() const { return this->max_us; };
+	double get_bucket_width_us() const { return this->bucket_width_us; };
+	//last bucket counts all values beyond bucket_count * bucket_width_us
+	const vector<unsigned long long> &get_buckets() const { return this->buckets; };
+
+private:
+	double bucket_width_us;
+	vector<unsigned long long> buckets;
+	unsigned long long samples;
+	double sum_us;
+	double min_us;
+	double max_us;
+};
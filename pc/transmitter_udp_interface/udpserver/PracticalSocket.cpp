@@ -31,10 +31,12 @@
   #include <arpa/inet.h>       // For inet_addr()
   #include <unistd.h>          // For close()
   #include <netinet/in.h>      // For sockaddr_in
+  #include <sys/select.h>      // For select()
   typedef void raw_type;       // Type used for raw data on this platform
 #endif
 
 #include <errno.h>             // For errno
+#include <cstring>             // For strerror() and memset()
 
 using namespace std;
 
@@ -349,6 +351,19 @@ int UDPSocket::recvFrom(void *buffer, int bufferLen, string &sourceAddress,
   return rtn;
 }
 
+bool UDPSocket::hasPendingDatagram() throw(SocketException) {
+  fd_set readSet;
+  FD_ZERO(&readSet);
+  FD_SET(sockDesc, &readSet);
+  timeval noWait = {0, 0};
+  int rtn;
+  if ((rtn = select(sockDesc + 1, &readSet, NULL, NULL, &noWait)) < 0) {
+    throw SocketException("Poll failed (select())", true);
+  }
+
+  return rtn > 0;
+}
+
 void UDPSocket::setMulticastTTL(unsigned char multicastTTL) throw(SocketException) {
   if (setsockopt(sockDesc, IPPROTO_IP, IP_MULTICAST_TTL, 
                  (raw_type *) &multicastTTL, sizeof(multicastTTL)) < 0) {
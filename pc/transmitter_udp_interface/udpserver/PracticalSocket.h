@@ -311,6 +311,14 @@ public:
   int recvFrom(void *buffer, int bufferLen, string &sourceAddress, 
                unsigned short &sourcePort) throw(SocketException);
 
+  /**
+   *   Check without blocking if a datagram is waiting, recvFrom() then
+   *   returns at once
+   *   @return true if a datagram can be received
+   *   @exception SocketException thrown if unable to poll the socket
+   */
+  bool hasPendingDatagram() throw(SocketException);
+
   /**
    *   Set the multicast TTL
    *   @param multicastTTL multicast TTL
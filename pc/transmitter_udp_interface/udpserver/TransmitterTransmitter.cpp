@@ -47,7 +47,7 @@ int main(int argc, char *argv[]) {
 		cout << "|  102 get_in_throttle: " << myTransmitter.get_in_throttle("192.168.0.102");
 		cout << "|  103 get_in_steer: " << myTransmitter.get_in_steer("192.168.0.103") ;
 		cout << "|  103 get_in_throttle: " << myTransmitter.get_in_throttle("192.168.0.103") << endl;
-		_sleep(50);
+		this_thread::sleep_for(chrono::milliseconds(50));
 	}
 
 	return 0;
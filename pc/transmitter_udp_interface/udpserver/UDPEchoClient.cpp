@@ -20,6 +20,7 @@
 #include "PracticalSocket.h"      // For UDPSocket and SocketException
 #include <iostream>               // For cout and cerr
 #include <cstdlib>                // For atoi()
+#include <cstring>                // For strlen()
 
 using namespace std;
 
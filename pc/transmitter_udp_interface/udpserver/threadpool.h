@@ -17,6 +17,8 @@ public:
 	template<class F, class... Args>
 	auto enqueue(F&& f, Args&&... args)
 		->std::future<typename std::result_of<F(Args...)>::type>;
+	// number of worker threads
+	size_t size() const { return workers.size(); }
 	~ThreadPool();
 private:
 	// need to keep track of threads so we can join them